@@ -13,8 +13,18 @@
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
 #include "PowerCircuitManager.h"
+#include "PowerStateBuffer.h"
+#include "PowerCommandQueue.h"
+#include "PowerEventQueue.h"
+#include "PowerElementRegistry.h"
+#include "PowerReachabilityTable.h"
+#include "PowerNodalSolver.h"
+#include "PowerSolveCache.h"
+#include "PowerEventStream.h"
+#include "PowerSolverState.h"
 //#include "Calc.h"
 #include <time.h>
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
@@ -942,5 +952,1340 @@ namespace IMS2Unit
 			delete s1;
 			delete c1;
 		}
+
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_AsyncTopologyRebuildTest)
+			TEST_DESCRIPTION(L"Tests if subcircuits rebuilt on a worker thread produce the same results as synchronously rebuilt ones.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_AsyncTopologyRebuildTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: AsyncTopologyRebuildTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *managers[2] = { new PowerCircuitManager(), new PowerCircuitManager() };
+			PowerBus *buses[2][3];
+			PowerSource *sources[2][2];
+			PowerConsumer *consumers[2][3];
+
+			managers[1]->SetAsyncTopologyRebuild(true);
+			Assert::IsTrue(managers[1]->IsAsyncTopologyRebuildEnabled(), L"Asynchronous rebuild should be enabled!");
+
+			//both managers get the same chain: S0 - B0 - B1 - B2 - S1, with a consumer on every bus.
+			for (int i = 0; i < 2; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					buses[i][j] = new PowerBus(10, 1000, managers[i], 0);
+					consumers[i][j] = new PowerConsumer(8, 12, 10 + 10 * j, 0);
+					consumers[i][j]->ConnectChildToParent(buses[i][j]);
+				}
+				sources[i][0] = new PowerSource(8, 12, 100, 1, 0);
+				sources[i][1] = new PowerSource(8, 12, 50, 2, 0);
+				buses[i][0]->ConnectChildToParent(sources[i][0]);
+				buses[i][0]->ConnectParentToChild(buses[i][1]);
+				buses[i][1]->ConnectParentToChild(buses[i][2]);
+				buses[i][2]->ConnectChildToParent(sources[i][1]);
+				for (int j = 0; j < 3; ++j)
+				{
+					consumers[i][j]->SetConsumerLoad(1);
+				}
+			}
+
+			Logger::WriteMessage(L"Testing evaluation before the rebuild is swapped in\n");
+			managers[0]->Evaluate(1);
+			managers[1]->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsEqual(sources[0][0]->GetOutputCurrent(), sources[1][0]->GetOutputCurrent()), L"Source output must not depend on subcircuits!");
+
+			Logger::WriteMessage(L"Testing evaluation after the rebuild is swapped in\n");
+			managers[1]->FinishTopologyRebuilds();
+			managers[0]->Evaluate(1);
+			managers[1]->Evaluate(1);
+			for (int j = 0; j < 3; ++j)
+			{
+				Logger::WriteMessage(TestUtils::Msg("Current throughput of B" + to_string(j) + ": " + to_string(buses[0][j]->GetCurrent()) + " synchronous, " + to_string(buses[1][j]->GetCurrent()) + " asynchronous\n"));
+				Assert::IsTrue(TestUtils::IsEqual(buses[0][j]->GetCurrent(), buses[1][j]->GetCurrent()), L"Asynchronously rebuilt bus has incorrect current!");
+			}
+
+			Logger::WriteMessage(L"Testing rebuild after disconnecting a bus\n");
+			for (int i = 0; i < 2; ++i)
+			{
+				buses[i][2]->DisconnectChildFromParent(buses[i][1]);
+			}
+			managers[0]->Evaluate(1);
+			managers[1]->Evaluate(1);
+			managers[1]->FinishTopologyRebuilds();
+			managers[0]->Evaluate(1);
+			managers[1]->Evaluate(1);
+			Assert::IsTrue(managers[1]->GetSize() == 2, L"Disconnecting the bus should have split the circuit!");
+			for (int j = 0; j < 3; ++j)
+			{
+				Assert::IsTrue(TestUtils::IsEqual(buses[0][j]->GetCurrent(), buses[1][j]->GetCurrent()), L"Asynchronously rebuilt bus has incorrect current after disconnecting!");
+			}
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			for (int i = 0; i < 2; ++i)
+			{
+				delete managers[i];
+				for (int j = 0; j < 3; ++j)
+				{
+					delete consumers[i][j];
+					delete buses[i][j];
+				}
+				delete sources[i][0];
+				delete sources[i][1];
+			}
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_StateBufferTest)
+			TEST_DESCRIPTION(L"Tests if the states published to state buffers match the elements, and can be read from another thread.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_StateBufferTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: StateBufferTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerConsumer *consumer1 = new PowerConsumer(15, 30, 60, 0);
+			PowerConsumer *consumer2 = new PowerConsumer(15, 30, 30, 0);
+			PowerBus *bus = new PowerBus(26, 1000, manager, 0);
+			PowerSourceChargable *chargablesource = new PowerSourceChargable(15, 30, 100, 200, 1000, 0.9, 1, 0, 0.2);
+			PowerSource *source = new PowerSource(15, 30, 300, 1, 0);
+
+			source->ConnectParentToChild(bus);
+			chargablesource->ConnectParentToChild(bus);
+			consumer1->ConnectChildToParent(bus);
+			consumer2->ConnectChildToParent(bus);
+			consumer1->SetConsumerLoad(1);
+			consumer2->SetConsumerLoad(0.5);
+
+			PowerStateBuffer *buffer1 = manager->CreateStateBuffer();
+			PowerStateBuffer *buffer2 = manager->CreateStateBuffer();
+			Assert::IsTrue(buffer1->Acquire()->frame == 0, L"Buffer should not contain a state before the first evaluation!");
+			Assert::IsFalse(buffer1->HasNewFrame(), L"Buffer should not have a new frame before the first evaluation!");
+
+			Logger::WriteMessage(L"Testing published state\n");
+			manager->Evaluate(1);
+			Assert::IsTrue(buffer1->HasNewFrame(), L"Buffer should have a new frame after evaluation!");
+			const POWER_STATE_FRAME *state = buffer1->Acquire();
+			Assert::IsFalse(buffer1->HasNewFrame(), L"Acquired frame is still reported as new!");
+			Assert::IsTrue(state->frame == 1, L"Published state has wrong frame number!");
+			Assert::IsTrue(state->buses.size() == 1 && state->sources.size() == 2 && state->chargables.size() == 1, L"Published state contains wrong number of elements!");
+			Assert::IsTrue(state->buses[0].bus == bus && TestUtils::IsEqual(state->buses[0].current, bus->GetCurrent()), L"Bus state does not match the bus!");
+			for (auto i = state->sources.begin(); i != state->sources.end(); ++i)
+			{
+				Assert::IsTrue(TestUtils::IsEqual(i->outputcurrent, i->source->GetOutputCurrent()), L"Source state does not match the source!");
+			}
+			Assert::IsTrue(state->chargables[0].chargable == chargablesource && TestUtils::IsEqual(state->chargables[0].charge, chargablesource->GetCharge()), L"Chargable state does not match the chargable source!");
+			bool foundconsumer = false;
+			for (auto i = state->consumers.begin(); i != state->consumers.end(); ++i)
+			{
+				if (i->consumer == consumer1)
+				{
+					foundconsumer = true;
+					Assert::IsTrue(TestUtils::IsEqual(i->inputcurrent, consumer1->GetInputCurrent()) && i->load == 1, L"Consumer state does not match the consumer!");
+				}
+			}
+			Assert::IsTrue(foundconsumer, L"Consumer is missing from the published state!");
+
+			Logger::WriteMessage(L"Testing that frames stay stable and skipped frames are dropped\n");
+			Assert::IsTrue(buffer1->Acquire() == state, L"Acquiring without a new evaluation should return the same frame!");
+			consumer1->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(state->frame == 1 && state->consumers.size() > 0, L"Acquired frame was changed by the simulation!");
+			manager->Evaluate(1);
+			manager->Evaluate(1);
+			state = buffer1->Acquire();
+			Assert::IsTrue(state->frame == 4, L"Reader did not get the newest frame!");
+			Assert::IsTrue(buffer2->Acquire()->frame == 4, L"Second buffer did not get the newest frame!");
+
+			Logger::WriteMessage(L"Testing reading from another thread\n");
+			bool framesinorder = true;
+			thread reader([buffer2, &framesinorder]() {
+				unsigned long long lastframe = 0;
+				while (lastframe < 1004)
+				{
+					const POWER_STATE_FRAME *frame = buffer2->Acquire();
+					if (frame->frame < lastframe || frame->buses.size() != 1)
+					{
+						framesinorder = false;
+					}
+					lastframe = frame->frame;
+				}
+			});
+			for (int i = 0; i < 1000; ++i)
+			{
+				manager->Evaluate(1);
+			}
+			reader.join();
+			Assert::IsTrue(framesinorder, L"Reading thread received inconsistent frames!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			manager->DeleteStateBuffer(buffer1);
+			delete manager;
+			delete bus;
+			delete consumer1;
+			delete consumer2;
+			delete chargablesource;
+			delete source;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_CommandQueueTest)
+			TEST_DESCRIPTION(L"Tests if commands posted from other threads are applied and coalesced during evaluation.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_CommandQueueTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: CommandQueueTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(26, 1000, manager, 0);
+			PowerSource *source = new PowerSource(15, 30, 300, 1, 0);
+			PowerConsumer *consumers[4];
+			source->ConnectParentToChild(bus);
+			for (int i = 0; i < 4; ++i)
+			{
+				consumers[i] = new PowerConsumer(15, 30, 26, 0);
+				consumers[i]->ConnectChildToParent(bus);
+				consumers[i]->SetConsumerLoad(0);
+			}
+			manager->Evaluate(1);
+
+			int loadchangedevents = 0;
+			consumers[0]->OnConsumerLoadChange([&loadchangedevents](PowerConsumer* it) { loadchangedevents++; });
+			PowerCommandQueue *queue = manager->GetCommandQueue();
+
+			Logger::WriteMessage(L"Testing coalescing of commands\n");
+			queue->PostConsumerLoad(consumers[0], 0.2);
+			queue->PostConsumerLoad(consumers[0], 0.5);
+			queue->PostChildSwitchedIn(consumers[1], false);
+			queue->PostConsumerLoad(consumers[0], 1);
+			Assert::IsTrue(consumers[0]->GetConsumerLoad() == 0, L"Command was applied before evaluation!");
+			manager->Evaluate(1);
+			Assert::IsTrue(consumers[0]->GetConsumerLoad() == 1, L"Consumer load was not set to the last posted value!");
+			Assert::IsTrue(loadchangedevents == 1, L"Consumer load should only have been changed once!");
+			Assert::IsFalse(consumers[1]->IsChildSwitchedIn(), L"Consumer was not switched out!");
+			Assert::IsTrue(source->GetOutputCurrent() > 1, L"Source current does not reflect the applied commands!");
+
+			Logger::WriteMessage(L"Testing posting from multiple threads\n");
+			vector<thread> posters;
+			for (int i = 0; i < 4; ++i)
+			{
+				PowerConsumer *consumer = consumers[i];
+				posters.push_back(thread([queue, consumer]() {
+					for (int j = 0; j < 1000; ++j)
+					{
+						queue->PostChildSwitchedIn(consumer, j % 2 == 0);
+						queue->PostConsumerLoad(consumer, j / 1000.0);
+					}
+				}));
+			}
+			//evaluate while the threads are posting. Commands only partially posted are left for the next evaluation.
+			for (int i = 0; i < 100; ++i)
+			{
+				manager->Evaluate(1);
+			}
+			for (auto i = posters.begin(); i != posters.end(); ++i)
+			{
+				i->join();
+			}
+			manager->Evaluate(1);
+			for (int i = 0; i < 4; ++i)
+			{
+				Assert::IsFalse(consumers[i]->IsChildSwitchedIn(), L"Last posted switch state was not applied!");
+				Assert::IsTrue(TestUtils::IsEqual(consumers[i]->GetConsumerLoad(), 0.999), L"Last posted load was not applied!");
+			}
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			for (int i = 0; i < 4; ++i)
+			{
+				delete consumers[i];
+			}
+			delete bus;
+			delete source;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_DeferredEventsTest)
+			TEST_DESCRIPTION(L"Tests if events during evaluation are fired once for their net change after evaluation.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_DeferredEventsTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: DeferredEventsTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 10, 1, 0);
+			PowerConsumer *consumer = new PowerConsumer(8, 12, 20, 0);
+			source->ConnectParentToChild(bus);
+			consumer->ConnectChildToParent(bus);
+			consumer->SetConsumerLoad(0.1);
+			manager->Evaluate(1);
+
+			int loadchangedevents = 0;
+			int buscurrentevents = 0;
+			bool firedduringevaluation = false;
+			double loadatevent = -1;
+			consumer->OnConsumerLoadChange([&](PowerConsumer* it) {
+				loadchangedevents++;
+				loadatevent = it->GetConsumerLoad();
+				firedduringevaluation = firedduringevaluation || manager->GetEventQueue()->IsRecording();
+			});
+			bus->OnCurrentThroughputChange([&buscurrentevents](PowerBus*) { buscurrentevents++; });
+
+			Logger::WriteMessage(L"Testing events outside of evaluation\n");
+			consumer->SetConsumerLoad(0.2);
+			Assert::IsTrue(loadchangedevents == 1, L"Event outside of evaluation was not fired immediately!");
+
+			Logger::WriteMessage(L"Testing deferred events during overload\n");
+			//the load is set by the queue during evaluation, then reduced again because the source can't provide enough current.
+			manager->GetCommandQueue()->PostConsumerLoad(consumer, 1);
+			manager->Evaluate(1);
+			Logger::WriteMessage(TestUtils::Msg("Load after overload: " + to_string(consumer->GetConsumerLoad()) + "\n"));
+			Assert::IsTrue(consumer->GetConsumerLoad() < 1, L"Overloaded consumer was not throttled!");
+			Assert::IsTrue(loadchangedevents == 2, L"Load change should have been fired once for the net change!");
+			Assert::IsTrue(loadatevent == consumer->GetConsumerLoad(), L"Deferred event did not see the final load!");
+			Assert::IsFalse(firedduringevaluation, L"Event was fired during evaluation!");
+			Assert::IsTrue(buscurrentevents == 1, L"Bus current change should have been fired once!");
+
+			Logger::WriteMessage(L"Testing immediate events during overload\n");
+			manager->SetDeferredEvents(false);
+			consumer->SetConsumerLoad(0.2);
+			manager->Evaluate(1);
+			loadchangedevents = 0;
+			manager->GetCommandQueue()->PostConsumerLoad(consumer, 1);
+			manager->Evaluate(1);
+			Assert::IsTrue(loadchangedevents == 2, L"Without deferral, every change of the load should fire!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			delete consumer;
+			delete bus;
+			delete source;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_EventStreamTest)
+			TEST_DESCRIPTION(L"Tests if events are written to the event stream, and if overflows are counted.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_EventStreamTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: EventStreamTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 100, 1, 0);
+			PowerConsumer *consumer = new PowerConsumer(8, 12, 20, 0);
+			source->ConnectParentToChild(bus);
+			consumer->ConnectChildToParent(bus);
+			consumer->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+
+			PowerEventStream *stream = manager->EnableEventStream(8);
+			PowerElementRegistry *registry = manager->GetRegistry();
+			Assert::IsTrue(stream->GetCapacity() == 8, L"Stream has wrong capacity!");
+			Assert::IsTrue(registry->GetHandle(consumer) == registry->GetHandle((PowerChild*)consumer), L"Handle depends on the type of the pointer!");
+			Assert::IsTrue(registry->GetHandle(consumer) != registry->GetHandle(bus), L"Different elements have the same handle!");
+			POWER_EVENT_STREAM_RECORD records[8];
+
+			Logger::WriteMessage(L"Testing events outside of evaluation\n");
+			consumer->SetChildSwitchedIn(false);
+			Assert::IsTrue(stream->Read(records, 8) == 1, L"Stream should contain exactly one event!");
+			Assert::IsTrue(records[0].element == registry->GetHandle(consumer) && records[0].type == PEVT_CHILD_SWITCH, L"Event has wrong element or type!");
+			Assert::IsTrue(records[0].oldvalue == 1 && records[0].newvalue == 0, L"Event has wrong values!");
+
+			Logger::WriteMessage(L"Testing events during evaluation\n");
+			manager->Evaluate(1);
+			unsigned int count = stream->Read(records, 8);
+			bool foundbusevent = false;
+			for (unsigned int i = 0; i < count; ++i)
+			{
+				Assert::IsTrue(records[i].frame == 2, L"Event has wrong frame number!");
+				if (records[i].element == registry->GetHandle(bus))
+				{
+					foundbusevent = true;
+					Assert::IsTrue(records[i].type == PEVT_BUS_CURRENT && records[i].newvalue == bus->GetCurrent() && records[i].limit == 1000, L"Bus event has wrong values!");
+				}
+			}
+			Assert::IsTrue(foundbusevent, L"Bus current change was not written to the stream!");
+
+			Logger::WriteMessage(L"Testing overflow\n");
+			for (int i = 0; i < 20; ++i)
+			{
+				consumer->SetChildSwitchedIn(i % 2 == 0);
+			}
+			Assert::IsTrue(stream->GetOverflowCount() == 12, L"Overflow was not counted correctly!");
+			Assert::IsTrue(stream->Read(records, 8) == 8, L"Stream should be full!");
+			Assert::IsTrue(records[0].newvalue == 1 && records[7].newvalue == 0, L"Stream did not keep the oldest events!");
+
+			Logger::WriteMessage(L"Testing reading from another thread\n");
+			unsigned long long overflowbefore = stream->GetOverflowCount();
+			unsigned int received = 0;
+			bool recordsvalid = true;
+			thread reader([stream, &received, &recordsvalid, overflowbefore]() {
+				POWER_EVENT_STREAM_RECORD buffer[4];
+				while (received + (stream->GetOverflowCount() - overflowbefore) < 1000)
+				{
+					unsigned int read = stream->Read(buffer, 4);
+					for (unsigned int i = 0; i < read; ++i)
+					{
+						recordsvalid = recordsvalid && buffer[i].type == PEVT_CHILD_SWITCH && buffer[i].oldvalue != buffer[i].newvalue;
+					}
+					received += read;
+				}
+			});
+			for (int i = 0; i < 1000; ++i)
+			{
+				consumer->SetChildSwitchedIn(i % 2 == 0);
+			}
+			reader.join();
+			Assert::IsTrue(recordsvalid, L"Reading thread received invalid events!");
+			Assert::IsTrue(received + (stream->GetOverflowCount() - overflowbefore) == 1000, L"Events were lost without being counted as overflow!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			manager->DisableEventStream();
+			Assert::IsTrue(manager->GetEventStream() == NULL, L"Stream was not disabled!");
+			delete manager;
+			delete consumer;
+			delete bus;
+			delete source;
+		}
+
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_MulticastEventsTest)
+			TEST_DESCRIPTION(L"Tests if multiple handlers can be registered for the same event, and removed again.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_MulticastEventsTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: MulticastEventsTest\n");
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 10, 1, 0);
+			PowerConsumer *consumer = new PowerConsumer(8, 12, 20, 0);
+			source->ConnectParentToChild(bus);
+			consumer->ConnectChildToParent(bus);
+			manager->Evaluate(1);
+
+			int firstevents = 0;
+			int secondevents = 0;
+			int buscurrentevents = 0;
+			int switchevents = 0;
+			int selfremovingevents = 0;
+			unsigned int first = consumer->OnConsumerLoadChange([&firstevents](PowerConsumer*) { firstevents++; });
+			unsigned int second = consumer->OnConsumerLoadChange([&secondevents](PowerConsumer*) { secondevents++; });
+			bus->OnCurrentThroughputChange([&buscurrentevents](PowerBus*) { buscurrentevents++; });
+			bus->OnCurrentThroughputChange([&buscurrentevents](PowerBus*) { buscurrentevents++; });
+			consumer->OnChildSwitchOut([&switchevents](PowerChild*) { switchevents++; });
+			Assert::IsTrue(first != second, L"Handlers did not receive distinct ids!");
+
+			Logger::WriteMessage(L"Testing that all handlers fire\n");
+			consumer->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(firstevents == 1 && secondevents == 1, L"Not all consumer handlers were called!");
+			Assert::IsTrue(buscurrentevents == 2, L"Not all bus handlers were called!");
+			Assert::IsTrue(switchevents == 0, L"Handler of a different event was called!");
+
+			Logger::WriteMessage(L"Testing removing handlers\n");
+			Assert::IsTrue(consumer->RemoveChildEventHandler(first), L"Handler was not removed!");
+			Assert::IsFalse(consumer->RemoveChildEventHandler(first), L"Handler was removed twice!");
+			Assert::IsFalse(bus->RemoveChildEventHandler(second), L"Handler of a different element was removed!");
+			consumer->SetConsumerLoad(0.2);
+			Assert::IsTrue(firstevents == 1 && secondevents == 2, L"Removed handler was called, or remaining handler was not!");
+
+			Logger::WriteMessage(L"Testing handlers removing themselves while being called\n");
+			unsigned int selfremoving = 0;
+			selfremoving = consumer->OnConsumerLoadChange([&](PowerConsumer* it) {
+				selfremovingevents++;
+				it->RemoveChildEventHandler(selfremoving);
+			});
+			consumer->OnConsumerLoadChange([&secondevents](PowerConsumer*) { secondevents++; });
+			consumer->SetConsumerLoad(0.3);
+			consumer->SetConsumerLoad(0.4);
+			Assert::IsTrue(selfremovingevents == 1, L"Handler was called after removing itself!");
+			Assert::IsTrue(secondevents == 6, L"Handlers after a removed one were not called!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			delete consumer;
+			delete bus;
+			delete source;
+		}
+
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_SolverStateTableTest)
+			TEST_DESCRIPTION(L"Tests if the solver state of elements is allocated from densely packed tables and returned when they are deleted.")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_SolverStateTableTest)
+		{
+			Logger::WriteMessage(L"\n\nTest: SolverStateTableTest\n");
+
+			PowerStateTable<CONSUMER_SOLVER_STATE> &consumertable = PowerStateTable<CONSUMER_SOLVER_STATE>::Get();
+			PowerStateTable<SOURCE_SOLVER_STATE> &sourcetable = PowerStateTable<SOURCE_SOLVER_STATE>::Get();
+			PowerStateTable<BUS_SOLVER_STATE> &bustable = PowerStateTable<BUS_SOLVER_STATE>::Get();
+			PowerStateTable<CHARGABLE_SOLVER_STATE> &chargabletable = PowerStateTable<CHARGABLE_SOLVER_STATE>::Get();
+			unsigned int consumersbefore = consumertable.GetSize();
+			unsigned int sourcesbefore = sourcetable.GetSize();
+			unsigned int busesbefore = bustable.GetSize();
+			unsigned int chargablesbefore = chargabletable.GetSize();
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 10, 1, 0);
+			PowerSourceChargable *battery = new PowerSourceChargable(8, 12, 10, 10, 10, 0.9, 1, 0, 0.1);
+			vector<PowerConsumer*> consumers;
+			for (int i = 0; i < 10; ++i)
+			{
+				consumers.push_back(new PowerConsumer(8, 12, 1, 0));
+			}
+			source->ConnectParentToChild(bus);
+			battery->ConnectParentToChild(bus);
+			for (auto i = consumers.begin(); i != consumers.end(); ++i)
+			{
+				(*i)->ConnectChildToParent(bus);
+				(*i)->SetConsumerLoad(0.5);
+			}
+
+			Logger::WriteMessage(L"Testing allocation\n");
+			Assert::IsTrue(consumertable.GetSize() == consumersbefore + 11, L"Consumers and rechargable source did not take a consumer slot each!");
+			Assert::IsTrue(sourcetable.GetSize() == sourcesbefore + 2, L"Source and rechargable source did not take a source slot each!");
+			Assert::IsTrue(bustable.GetSize() == busesbefore + 1, L"Bus did not take a bus slot!");
+			Assert::IsTrue(chargabletable.GetSize() == chargablesbefore + 1, L"Rechargable source did not take a chargable slot!");
+
+			Logger::WriteMessage(L"Testing evaluation on table state\n");
+			manager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(bus->GetCurrent(), 0.5, 1e-9), L"Bus current is incorrect!");
+			Assert::IsTrue(TestUtils::IsNear(consumers[0]->GetInputCurrent(), 0.05, 1e-9), L"Consumer current is incorrect!");
+			Assert::IsTrue(consumers[0]->GetInputVoltageInfo().minimum == 8 && consumers[0]->GetInputVoltageInfo().current == 10, L"Voltage info was not assembled correctly!");
+
+			Logger::WriteMessage(L"Testing slot reuse\n");
+			delete consumers.back();
+			consumers.pop_back();
+			Assert::IsTrue(consumertable.GetSize() == consumersbefore + 10, L"Slot was not returned on deletion!");
+			consumers.push_back(new PowerConsumer(8, 12, 1, 0));
+			Assert::IsTrue(consumertable.GetSize() == consumersbefore + 11, L"Slot was not reused!");
+			Assert::IsTrue(consumers.back()->GetConsumerLoad() == -1 && consumers.back()->IsRunning(), L"Reused slot was not reset!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			for (auto i = consumers.begin(); i != consumers.end(); ++i)
+			{
+				delete (*i);
+			}
+			delete battery;
+			delete source;
+			delete bus;
+			Assert::IsTrue(consumertable.GetSize() == consumersbefore && sourcetable.GetSize() == sourcesbefore &&
+				bustable.GetSize() == busesbefore && chargabletable.GetSize() == chargablesbefore, L"Not all slots were returned!");
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_ElementRegistryTest)
+			TEST_DESCRIPTION(L"Tests that element handles are stable, resolve to the right element and become invalid when the element is deleted")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_ElementRegistryTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerElementRegistry *registry = manager->GetRegistry();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 100, 1, 0);
+			PowerSourceChargable *battery = new PowerSourceChargable(8, 12, 10, 10, 10, 0.9, 1, 0, 0.1);
+			PowerConsumer *consumer = new PowerConsumer(8, 12, 20, 0);
+			PowerConsumer *unconnected = new PowerConsumer(8, 12, 20, 0);
+			source->ConnectParentToChild(bus);
+			battery->ConnectParentToChild(bus);
+			consumer->ConnectChildToParent(bus);
+
+			Logger::WriteMessage(L"Testing handles\n");
+			POWER_HANDLE bushandle = registry->GetHandle(bus);
+			POWER_HANDLE sourcehandle = registry->GetHandle(source);
+			POWER_HANDLE batteryhandle = registry->GetHandle(battery);
+			POWER_HANDLE consumerhandle = registry->GetHandle(consumer);
+			Assert::IsTrue(bushandle != 0 && sourcehandle != 0 && batteryhandle != 0 && consumerhandle != 0, L"Registered element has no handle!");
+			Assert::IsTrue(registry->GetHandle(unconnected) == 0, L"Unconnected element has a handle!");
+			Assert::IsTrue(bushandle != sourcehandle && bushandle != batteryhandle && bushandle != consumerhandle &&
+				sourcehandle != batteryhandle && sourcehandle != consumerhandle && batteryhandle != consumerhandle, L"Elements share a handle!");
+			Assert::IsTrue(registry->GetHandle((PowerChild*)bus) == bushandle && registry->GetHandle((PowerParent*)bus) == bushandle, L"Bus has different handles on its sides!");
+			Assert::IsTrue(registry->GetHandle((PowerConsumer*)battery) == batteryhandle, L"Rechargable source has different handles on its sides!");
+			Assert::IsTrue(registry->GetSize() == 4, L"Registry has wrong size!");
+
+			Logger::WriteMessage(L"Testing resolution\n");
+			Assert::IsTrue(registry->ResolveBus(bushandle) == bus && registry->ResolveSource(sourcehandle) == source &&
+				registry->ResolveConsumer(consumerhandle) == consumer, L"Handle resolved to the wrong element!");
+			Assert::IsTrue(registry->ResolveSource(batteryhandle) == battery && registry->ResolveConsumer(batteryhandle) == battery, L"Rechargable source not resolved on both sides!");
+			Assert::IsTrue(registry->ResolveBus(sourcehandle) == NULL && registry->ResolveSource(consumerhandle) == NULL &&
+				registry->ResolveConsumer(bushandle) == NULL, L"Handle resolved to an element of the wrong type!");
+			Assert::IsTrue(registry->ResolveChild(0) == NULL && !registry->IsValid(0), L"Handle 0 is valid!");
+
+			Logger::WriteMessage(L"Testing state frame handles\n");
+			PowerStateBuffer *buffer = manager->CreateStateBuffer();
+			manager->Evaluate(1);
+			const POWER_STATE_FRAME *frame = buffer->Acquire();
+			Assert::IsTrue(frame->buses[0].handle == bushandle && frame->consumers.size() > 0 && frame->chargables[0].handle == batteryhandle, L"State frame has wrong handles!");
+
+			Logger::WriteMessage(L"Testing outdated handles\n");
+			delete consumer;
+			Assert::IsTrue(!registry->IsValid(consumerhandle) && registry->ResolveConsumer(consumerhandle) == NULL, L"Handle of deleted element is still valid!");
+			Assert::IsTrue(registry->GetSize() == 3, L"Deleted element was not removed from the registry!");
+			unconnected->ConnectChildToParent(bus);
+			POWER_HANDLE reusedhandle = registry->GetHandle(unconnected);
+			Assert::IsTrue(PowerElementRegistry::GetHandleIndex(reusedhandle) == PowerElementRegistry::GetHandleIndex(consumerhandle), L"Slot was not reused!");
+			Assert::IsTrue(reusedhandle != consumerhandle && registry->ResolveConsumer(consumerhandle) == NULL, L"Outdated handle resolves to the new element!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			//the manager goes first, the elements must not touch its registry afterwards.
+			delete manager;
+			delete unconnected;
+			delete battery;
+			delete source;
+			delete bus;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_ElementFactoryTest)
+			TEST_DESCRIPTION(L"Tests that elements created through the factories of the manager work as usual and are released with the manager")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_ElementFactoryTest)
+		{
+			PowerStateTable<CONSUMER_SOLVER_STATE> &consumertable = PowerStateTable<CONSUMER_SOLVER_STATE>::Get();
+			PowerStateTable<BUS_SOLVER_STATE> &bustable = PowerStateTable<BUS_SOLVER_STATE>::Get();
+			unsigned int consumersbefore = consumertable.GetSize();
+			unsigned int busesbefore = bustable.GetSize();
+
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = manager->CreateBus(10, 1000, 0);
+			PowerSource *source = manager->CreateSource(8, 12, 100, 1, 0);
+			PowerSourceChargable *battery = manager->CreateChargableSource(8, 12, 10, 10, 10, 0.9, 1, 0, 0.1);
+			PowerConverter *converter = manager->CreateConverter(8, 12, 10, 0.9, 1, 0);
+			vector<PowerConsumer*> consumers;
+			for (int i = 0; i < 100; ++i)
+			{
+				consumers.push_back(manager->CreateConsumer(8, 12, 1, 0));
+			}
+			Assert::IsTrue(manager->GetPooledElementCount() == 104, L"Wrong number of pooled elements!");
+			Assert::IsTrue(manager->GetRegistry()->GetHandle(consumers[0]) != 0 && manager->GetRegistry()->GetHandle(source) != 0, L"Pooled elements were not registered!");
+
+			Logger::WriteMessage(L"Testing evaluation\n");
+			source->ConnectParentToChild(bus);
+			battery->ConnectParentToChild(bus);
+			for (auto i = consumers.begin(); i != consumers.end(); ++i)
+			{
+				(*i)->ConnectChildToParent(bus);
+				(*i)->SetConsumerLoad(0.5);
+			}
+			manager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(bus->GetCurrent(), 5, 1e-9), L"Bus current is incorrect!");
+
+			Logger::WriteMessage(L"Testing deletion\n");
+			PowerConsumer *spare = manager->CreateConsumer(8, 12, 1, 0);
+			spare->SetConsumerLoad(1);
+			manager->DeleteConsumer(spare);
+			Assert::IsTrue(manager->GetPooledElementCount() == 104, L"Element was not removed from the pool!");
+			PowerConsumer *reused = manager->CreateConsumer(8, 12, 1, 0);
+			Assert::IsTrue(reused == spare && reused->GetConsumerLoad() == -1, L"Slot was not reused!");
+			manager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(bus->GetCurrent(), 5, 1e-9), L"Unconnected element changed the bus current!");
+
+			Logger::WriteMessage(L"Testing release with the manager\n");
+			delete manager;
+			Assert::IsTrue(consumertable.GetSize() == consumersbefore && bustable.GetSize() == busesbefore, L"Pooled elements were not destroyed with the manager!");
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_MemoryResourceTest)
+			TEST_DESCRIPTION(L"Tests that a manager allocates from the memory resource it was created with")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_MemoryResourceTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			CountingMemoryResource resource;
+			PowerCircuitManager *manager = new PowerCircuitManager(&resource);
+			Assert::IsTrue(manager->GetMemoryResource() == &resource, L"Manager does not use the resource!");
+			PowerBus *bus = manager->CreateBus(10, 1000, 0);
+			PowerSource *source = manager->CreateSource(8, 12, 100, 1, 0);
+			PowerConsumer *consumer = manager->CreateConsumer(8, 12, 20, 0);
+			PowerConsumer *heapconsumer = new PowerConsumer(8, 12, 20, 0);
+
+			Logger::WriteMessage(L"Testing allocation\n");
+			unsigned int allocations = resource.allocations;
+			source->ConnectParentToChild(bus);
+			consumer->ConnectChildToParent(bus);
+			heapconsumer->ConnectChildToParent(bus);
+			consumer->SetConsumerLoad(1);
+			heapconsumer->SetConsumerLoad(1);
+			manager->Evaluate(1);
+			Assert::IsTrue(resource.allocations > allocations, L"Connecting and evaluating did not allocate from the resource!");
+			Assert::IsTrue(TestUtils::IsNear(source->GetOutputCurrent(), 4, 1e-9), L"Evaluation on the resource gives wrong results!");
+
+			Logger::WriteMessage(L"Testing evaluation without structural changes\n");
+			allocations = resource.allocations;
+			long long outstanding = resource.outstanding;
+			consumer->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(resource.outstanding == outstanding, L"Evaluation leaked memory on the resource!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete heapconsumer;
+			delete manager;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_InlineAdjacencyTest)
+			TEST_DESCRIPTION(L"Tests that elements with few connections don't allocate for their adjacency, and that larger ones still work")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_InlineAdjacencyTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			CountingMemoryResource resource;
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 100, 1, 0, false, &resource);
+			vector<PowerConsumer*> consumers;
+			for (int i = 0; i < 8; ++i)
+			{
+				consumers.push_back(new PowerConsumer(8, 12, 10, 0, -1, 0.01, false, &resource));
+			}
+
+			Logger::WriteMessage(L"Testing inline adjacency\n");
+			source->ConnectParentToChild(bus);
+			for (auto i = consumers.begin(); i != consumers.end(); ++i)
+			{
+				(*i)->ConnectChildToParent(bus);
+				(*i)->SetConsumerLoad(1);
+			}
+			manager->Evaluate(1);
+			Assert::IsTrue(resource.allocations == 0, L"Elements with a single connection allocated memory!");
+			Assert::IsTrue(TestUtils::IsNear(source->GetOutputCurrent(), 8, 1e-9), L"Source has wrong output current!");
+
+			Logger::WriteMessage(L"Testing spilled adjacency\n");
+			vector<PowerChild*> children;
+			bus->GetChildren(children);
+			Assert::IsTrue(children.size() == 8 && children[7] == consumers[7], L"Bus lost children when growing beyond the inline size!");
+			consumers[3]->DisconnectChildFromParent(bus);
+			children.clear();
+			bus->GetChildren(children);
+			Assert::IsTrue(children.size() == 7 && children[3] == consumers[4], L"Removing a child broke the order!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			for (auto i = consumers.begin(); i != consumers.end(); ++i)
+			{
+				delete (*i);
+			}
+			delete source;
+			delete bus;
+			Assert::IsTrue(resource.outstanding == 0, L"Adjacency leaked memory!");
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_SpanAccessorsTest)
+			TEST_DESCRIPTION(L"Tests that the span accessors expose the same lists as the copying getters")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_SpanAccessorsTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = new PowerBus(10, 1000, manager, 0);
+			PowerBus *bus2 = new PowerBus(10, 1000, manager, 0);
+			PowerSource *source = new PowerSource(8, 12, 100, 1, 0);
+			PowerConsumer *consumer = new PowerConsumer(8, 12, 20, 0);
+			source->ConnectParentToChild(bus);
+			bus->ConnectParentToChild(bus2);
+			consumer->ConnectChildToParent(bus2);
+
+			Logger::WriteMessage(L"Testing element spans\n");
+			PowerSpan<PowerChild*> children = bus->GetChildren();
+			vector<PowerChild*> childcopy;
+			bus->GetChildren(childcopy);
+			Assert::IsTrue(children.size() == childcopy.size() && equal(children.begin(), children.end(), childcopy.begin()), L"Children span differs from copy!");
+			PowerSpan<PowerParent*> parents = bus2->GetParents();
+			Assert::IsTrue(parents.size() == 1 && parents[0] == bus, L"Parents span is wrong!");
+			Assert::IsTrue(consumer->GetParents()[0] == bus2 && source->GetChildren()[0] == bus, L"Spans of single connections are wrong!");
+
+			Logger::WriteMessage(L"Testing circuit spans\n");
+			PowerSpan<PowerCircuit*> circuits = manager->GetPowerCircuits();
+			Assert::IsTrue(circuits.size() == 1, L"Wrong number of circuits!");
+			PowerSpan<PowerBus*> buses = circuits[0]->GetPowerBuses();
+			PowerSpan<PowerSource*> sources = circuits[0]->GetPowerSources();
+			Assert::IsTrue(buses.size() == 2 && find(buses.begin(), buses.end(), bus2) != buses.end(), L"Buses span is wrong!");
+			Assert::IsTrue(sources.size() == 1 && sources[0] == source, L"Sources span is wrong!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+			delete consumer;
+			delete source;
+			delete bus2;
+			delete bus;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_BulkQueryTest)
+			TEST_DESCRIPTION(L"Tests that the bulk queries return the same values as the getters of the elements")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_BulkQueryTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerElementRegistry *registry = manager->GetRegistry();
+			PowerBus *bus = manager->CreateBus(10, 1000, 0);
+			PowerSource *source = manager->CreateSource(8, 12, 100, 1, 0);
+			PowerSourceChargable *battery = manager->CreateChargableSource(8, 12, 10, 10, 10, 0.9, 1, 0, 0.1);
+			vector<PowerConsumer*> consumers;
+			source->ConnectParentToChild(bus);
+			battery->ConnectParentToChild(bus);
+			for (int i = 0; i < 10; ++i)
+			{
+				consumers.push_back(manager->CreateConsumer(8, 12, 10, 0));
+				consumers.back()->ConnectChildToParent(bus);
+				consumers.back()->SetConsumerLoad(i * 0.1);
+			}
+			consumers[3]->SetRunning(false);
+			manager->Evaluate(1);
+
+			Logger::WriteMessage(L"Testing handle filters\n");
+			Assert::IsTrue(registry->GetHandles(PEK_BUS, NULL, 0) == 1, L"Wrong number of buses!");
+			Assert::IsTrue(registry->GetHandles(PEK_SOURCE, NULL, 0) == 2, L"Wrong number of sources!");
+			Assert::IsTrue(registry->GetHandles(PEK_CHARGABLE, NULL, 0) == 1, L"Wrong number of chargables!");
+			//the battery is a consumer as well.
+			vector<POWER_HANDLE> handles(registry->GetHandles(PEK_CONSUMER, NULL, 0));
+			Assert::IsTrue(handles.size() == 11, L"Wrong number of consumers!");
+			Assert::IsTrue(registry->GetHandles(PEK_CONSUMER, handles.data(), handles.size()) == handles.size(), L"Handles were not written!");
+
+			Logger::WriteMessage(L"Testing consumer query\n");
+			vector<double> loads(handles.size()), currents(handles.size());
+			bool running[11], switchedin[11];
+			manager->QueryConsumerStates(handles.data(), handles.size(), loads.data(), currents.data(), running, switchedin);
+			for (unsigned int i = 0; i < handles.size(); ++i)
+			{
+				PowerConsumer *consumer = (PowerConsumer*)registry->ResolveChild(handles[i]);
+				Assert::IsTrue(loads[i] == consumer->GetConsumerLoad() && currents[i] == consumer->GetInputCurrent(), L"Consumer values differ from getters!");
+				Assert::IsTrue(running[i] == consumer->IsRunning() && switchedin[i] == consumer->IsChildSwitchedIn(), L"Consumer flags differ from getters!");
+			}
+
+			Logger::WriteMessage(L"Testing bus, source and charge queries\n");
+			POWER_HANDLE mixed[3] = { registry->GetHandle(bus), registry->GetHandle(battery), 0 };
+			double values[3], maxvalues[3];
+			manager->QueryBusCurrents(mixed, 3, values, maxvalues);
+			Assert::IsTrue(values[0] == bus->GetCurrent() && maxvalues[0] == 1000, L"Bus current differs from getter!");
+			Assert::IsTrue(values[1] == 0 && values[2] == 0 && maxvalues[2] == 0, L"Mismatched handles were not zeroed!");
+			manager->QuerySourceStates(mixed, 3, values);
+			Assert::IsTrue(values[0] == 0 && values[1] == battery->GetOutputCurrent(), L"Source current differs from getter!");
+			manager->QueryCharges(mixed, 3, values, maxvalues);
+			Assert::IsTrue(values[1] == battery->GetCharge() && maxvalues[1] == battery->GetMaxCharge(), L"Charge differs from getter!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_BatchMutationTest)
+			TEST_DESCRIPTION(L"Tests that batch setters give the same results as setting loads and switch states one by one")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_BatchMutationTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *batchmanager = new PowerCircuitManager();
+			PowerCircuitManager *singlemanager = new PowerCircuitManager();
+			PowerCircuitManager *managers[2] = { batchmanager, singlemanager };
+			PowerSource *sources[2];
+			vector<PowerConsumer*> consumers[2];
+			for (int m = 0; m < 2; ++m)
+			{
+				PowerBus *bus = managers[m]->CreateBus(10, 1000, 0);
+				PowerBus *bus2 = managers[m]->CreateBus(10, 1000, 0);
+				sources[m] = managers[m]->CreateSource(8, 12, 1000, 0.01, 0);
+				sources[m]->ConnectParentToChild(bus);
+				sources[m]->ConnectParentToChild(bus2);
+				for (int i = 0; i < 20; ++i)
+				{
+					consumers[m].push_back(managers[m]->CreateConsumer(8, 12, 10, 0));
+					consumers[m].back()->ConnectChildToParent(i % 2 == 0 ? bus : bus2);
+					consumers[m].back()->SetConsumerLoad(0.5);
+				}
+				managers[m]->Evaluate(1);
+			}
+			int loadevents = 0;
+			for (auto i = consumers[0].begin(); i != consumers[0].end(); ++i)
+			{
+				(*i)->OnConsumerLoadChange([&loadevents](PowerConsumer *consumer) { loadevents++; });
+			}
+
+			Logger::WriteMessage(L"Testing batch loads\n");
+			vector<POWER_HANDLE> handles;
+			vector<double> loads;
+			for (unsigned int i = 0; i < consumers[0].size(); ++i)
+			{
+				handles.push_back(batchmanager->GetRegistry()->GetHandle(consumers[0][i]));
+				loads.push_back(i == 0 ? 0.001 : (i % 10) * 0.1);
+				consumers[1][i]->SetConsumerLoad(loads.back());
+			}
+			handles.push_back(0);
+			loads.push_back(1);
+			unsigned int rejected = batchmanager->SetConsumerLoads(PowerSpan<POWER_HANDLE>(handles.data(), handles.size()), PowerSpan<double>(loads.data(), loads.size()));
+			Assert::IsTrue(rejected == 2, L"Wrong number of rejected loads!");
+			Assert::IsTrue(loadevents == 18, L"Wrong number of load events!");
+			batchmanager->Evaluate(1);
+			singlemanager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(sources[0]->GetOutputCurrent(), sources[1]->GetOutputCurrent(), 1e-9), L"Batch loads give a different result!");
+
+			Logger::WriteMessage(L"Testing batch switching\n");
+			bool switchedin[20];
+			for (unsigned int i = 0; i < 20; ++i)
+			{
+				switchedin[i] = i % 3 != 0;
+				consumers[1][i]->SetChildSwitchedIn(switchedin[i]);
+			}
+			batchmanager->SetChildrenSwitchedIn(PowerSpan<POWER_HANDLE>(handles.data(), 20), PowerSpan<bool>(switchedin, 20));
+			Assert::IsTrue(!consumers[0][3]->IsChildSwitchedIn() && consumers[0][4]->IsChildSwitchedIn(), L"Children were not switched!");
+			batchmanager->Evaluate(1);
+			singlemanager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(sources[0]->GetOutputCurrent(), sources[1]->GetOutputCurrent(), 1e-9), L"Batch switching gives a different result!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete batchmanager;
+			delete singlemanager;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_ReachabilityTableTest)
+			TEST_DESCRIPTION(L"Tests that the reachability table of a circuit has one mask per feeding edge and reports the bus currents")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_ReachabilityTableTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *buses[3];
+			PowerConsumer *consumers[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				buses[i] = manager->CreateBus(10, 1000, 0);
+				consumers[i] = manager->CreateConsumer(8, 12, 10 + 10 * i, 0);
+				consumers[i]->ConnectChildToParent(buses[i]);
+			}
+			//S0 - B0 - B1 - B2 - S1
+			PowerSource *source0 = manager->CreateSource(8, 12, 100, 1, 0);
+			PowerSource *source1 = manager->CreateSource(8, 12, 50, 2, 0);
+			buses[0]->ConnectChildToParent(source0);
+			buses[0]->ConnectParentToChild(buses[1]);
+			buses[1]->ConnectParentToChild(buses[2]);
+			buses[2]->ConnectChildToParent(source1);
+			for (int i = 0; i < 3; ++i)
+			{
+				consumers[i]->SetConsumerLoad(1);
+			}
+			manager->Evaluate(1);
+
+			Logger::WriteMessage(L"Testing table layout\n");
+			PowerReachabilityTable *table = buses[0]->GetCircuit()->GetReachabilityTable();
+			Assert::IsTrue(table->GetEdgeCount() == 6, L"There should be one edge per parent of every bus!");
+			Assert::IsTrue(table->GetMaskSize() == 6 * sizeof(unsigned long long), L"Five elements should fit into a single word per edge!");
+
+			Logger::WriteMessage(L"Testing through-currents\n");
+			for (int i = 0; i < 3; ++i)
+			{
+				Assert::IsTrue(table->GetThroughCurrent(buses[i]) == buses[i]->GetCurrent(), L"Table and bus disagree on the current!");
+			}
+			consumers[1]->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(table->GetThroughCurrent(buses[1]) == buses[1]->GetCurrent(), L"Table was not updated after a load change!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_IncrementalSurplusTest)
+			TEST_DESCRIPTION(L"Tests that bus currents maintained incrementally over many changes match those of a freshly built circuit")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_IncrementalSurplusTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *managers[2] = { new PowerCircuitManager(), new PowerCircuitManager() };
+			PowerBus *buses[2][4];
+			PowerConsumer *consumers[2][4];
+			for (int m = 0; m < 2; ++m)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					buses[m][i] = managers[m]->CreateBus(10, 1000, 0);
+					consumers[m][i] = managers[m]->CreateConsumer(8, 12, 10 + 5 * i, 0);
+					consumers[m][i]->ConnectChildToParent(buses[m][i]);
+					if (i > 0)
+					{
+						buses[m][i - 1]->ConnectParentToChild(buses[m][i]);
+					}
+				}
+				buses[m][0]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 100, 1, 0));
+				buses[m][3]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 50, 2, 0));
+			}
+
+			Logger::WriteMessage(L"Changing loads incrementally\n");
+			for (int i = 0; i < 4; ++i)
+			{
+				consumers[0][i]->SetConsumerLoad(1);
+			}
+			managers[0]->Evaluate(1);
+			for (int step = 0; step < 50; ++step)
+			{
+				consumers[0][step % 4]->SetConsumerLoad(0.1 + (step * 7 % 10) * 0.09);
+				managers[0]->Evaluate(1);
+			}
+
+			Logger::WriteMessage(L"Comparing with a fresh evaluation\n");
+			for (int i = 0; i < 4; ++i)
+			{
+				consumers[1][i]->SetConsumerLoad(consumers[0][i]->GetConsumerLoad());
+			}
+			managers[1]->Evaluate(1);
+			for (int i = 0; i < 4; ++i)
+			{
+				Logger::WriteMessage(TestUtils::Msg("Current throughput of B" + to_string(i) + ": " + to_string(buses[0][i]->GetCurrent()) + " incremental, " + to_string(buses[1][i]->GetCurrent()) + " fresh\n"));
+				Assert::IsTrue(TestUtils::IsEqual(buses[0][i]->GetCurrent(), buses[1][i]->GetCurrent()), L"Incrementally maintained current differs!");
+			}
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete managers[0];
+			delete managers[1];
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_TopologyReductionTest)
+			TEST_DESCRIPTION(L"Tests that reducing chains and leaves of buses shrinks the reachability table without changing the bus currents")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_TopologyReductionTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *managers[2] = { new PowerCircuitManager(), new PowerCircuitManager() };
+			managers[1]->SetTopologyReduction(true);
+			PowerBus *buses[2][8];
+			PowerConsumer *consumers[2][8];
+			for (int m = 0; m < 2; ++m)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					buses[m][i] = managers[m]->CreateBus(10, 1000, 0);
+					consumers[m][i] = managers[m]->CreateConsumer(8, 12, 5 + 5 * i, 0);
+					consumers[m][i]->ConnectChildToParent(buses[m][i]);
+				}
+				//S0 - B0 - B1 - B2 - B3 - S1, B3 - B4, a loop B4 - B5 - B6 - B4, and a leaf B6 - B7
+				buses[m][0]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 100, 1, 0));
+				buses[m][3]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 50, 2, 0));
+				for (int i = 0; i < 6; ++i)
+				{
+					buses[m][i]->ConnectParentToChild(buses[m][i + 1]);
+				}
+				buses[m][6]->ConnectParentToChild(buses[m][4]);
+				buses[m][6]->ConnectParentToChild(buses[m][7]);
+			}
+
+			Logger::WriteMessage(L"Testing table layout\n");
+			for (int m = 0; m < 2; ++m)
+			{
+				for (int i = 0; i < 8; ++i)
+				{
+					consumers[m][i]->SetConsumerLoad(1);
+				}
+				managers[m]->Evaluate(1);
+			}
+			PowerReachabilityTable *tables[2] = { buses[0][0]->GetCircuit()->GetReachabilityTable(), buses[1][0]->GetCircuit()->GetReachabilityTable() };
+			Assert::IsTrue(tables[0]->GetEdgeCount() == tables[1]->GetEdgeCount(), L"Reduction should not change the number of edges!");
+			Assert::IsTrue(tables[0]->GetDerivedEdgeCount() == 0, L"Nothing should be derived without reduction!");
+			Assert::IsTrue(tables[1]->GetDerivedEdgeCount() > 0, L"Chain and leaf edges should have been derived!");
+			Assert::IsTrue(tables[1]->GetMaskSize() < tables[0]->GetMaskSize(), L"Derived edges should not store masks!");
+
+			Logger::WriteMessage(L"Testing through-currents\n");
+			for (int step = 0; step < 20; ++step)
+			{
+				for (int m = 0; m < 2; ++m)
+				{
+					consumers[m][step % 8]->SetConsumerLoad(0.1 + (step * 7 % 10) * 0.09);
+					managers[m]->Evaluate(1);
+				}
+				for (int i = 0; i < 8; ++i)
+				{
+					Assert::IsTrue(TestUtils::IsEqual(buses[0][i]->GetCurrent(), buses[1][i]->GetCurrent()), L"Reduced table reports a different current!");
+				}
+			}
+
+			Logger::WriteMessage(L"Testing switching reduction off again\n");
+			managers[1]->SetTopologyReduction(false);
+			managers[1]->Evaluate(1);
+			Assert::IsTrue(tables[1]->GetDerivedEdgeCount() == 0, L"Table was not rebuilt after disabling reduction!");
+			for (int i = 0; i < 8; ++i)
+			{
+				Assert::IsTrue(TestUtils::IsEqual(buses[0][i]->GetCurrent(), buses[1][i]->GetCurrent()), L"Current changed after disabling reduction!");
+			}
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete managers[0];
+			delete managers[1];
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_NodalSolverTest)
+			TEST_DESCRIPTION(L"Tests that the nodal solver agrees with reachability tables on trees, splits current in loops by resistance and only refactorizes when resistances change")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_NodalSolverTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *managers[2] = { new PowerCircuitManager(), new PowerCircuitManager() };
+			managers[1]->SetNodalSolver(true);
+			PowerBus *buses[2][4];
+			PowerConsumer *consumers[2][4];
+			for (int m = 0; m < 2; ++m)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					buses[m][i] = managers[m]->CreateBus(10, 1000, 0);
+					consumers[m][i] = managers[m]->CreateConsumer(8, 12, 10 + 5 * i, 0);
+					consumers[m][i]->ConnectChildToParent(buses[m][i]);
+					consumers[m][i]->SetConsumerLoad(1);
+					if (i > 0)
+					{
+						buses[m][i - 1]->ConnectParentToChild(buses[m][i]);
+					}
+				}
+				//S0 - B0 - B1 - B2 - B3 - S1
+				buses[m][0]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 100, 1, 0));
+				buses[m][3]->ConnectChildToParent(managers[m]->CreateSource(8, 12, 50, 2, 0));
+				buses[m][1]->SetResistance(0.5);
+				managers[m]->Evaluate(1);
+			}
+
+			Logger::WriteMessage(L"Testing tree\n");
+			for (int i = 0; i < 4; ++i)
+			{
+				Assert::IsTrue(TestUtils::IsNear(buses[0][i]->GetCurrent(), buses[1][i]->GetCurrent(), 1e-6), L"Nodal solver disagrees with the reachability table on a tree!");
+			}
+
+			Logger::WriteMessage(L"Testing loops\n");
+			PowerCircuitManager *manager = managers[1];
+			Assert::IsTrue(buses[1][3]->CanConnectToParent(buses[1][0]), L"Nodal solver should allow loops!");
+			Assert::IsFalse(buses[0][3]->CanConnectToParent(buses[0][0]), L"Reachability tables should not allow loops!");
+			//S - R0 - R1 - R2 - R3 - R0, with a load on R2 only. The path through R1 has four times the resistance of the one through R3.
+			PowerBus *ring[4];
+			PowerConsumer *load = manager->CreateConsumer(8, 12, 50, 0);
+			for (int i = 0; i < 4; ++i)
+			{
+				ring[i] = manager->CreateBus(10, 1000, 0);
+				if (i > 0)
+				{
+					ring[i - 1]->ConnectParentToChild(ring[i]);
+				}
+			}
+			ring[0]->ConnectChildToParent(manager->CreateSource(8, 12, 100, 1, 0));
+			ring[3]->ConnectChildToParent(ring[0]);
+			load->ConnectChildToParent(ring[2]);
+			load->SetConsumerLoad(1);
+			ring[1]->SetResistance(1);
+			ring[3]->SetResistance(0.25);
+			manager->Evaluate(1);
+			PowerNodalSolver *solver = ring[0]->GetCircuit()->GetNodalSolver();
+			Assert::IsTrue(solver->GetLinkCount() == 5, L"There should be one link per bus connection and source!");
+			double total = ring[2]->GetCurrent();
+			Assert::IsTrue(total > 0, L"Loaded bus should draw current!");
+			Assert::IsTrue(TestUtils::IsNear(ring[0]->GetCurrent(), total, 1e-6), L"All current should come from the source!");
+			Assert::IsTrue(TestUtils::IsNear(ring[1]->GetCurrent(), total * 0.2, 1e-6), L"Current did not split by resistance!");
+			Assert::IsTrue(TestUtils::IsNear(ring[3]->GetCurrent(), total * 0.8, 1e-6), L"Current did not split by resistance!");
+
+			Logger::WriteMessage(L"Testing refactorization\n");
+			unsigned int factorizations = solver->GetFactorizationCount();
+			load->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(ring[2]->GetCurrent() < total, L"Current did not follow the load!");
+			Assert::IsTrue(solver->GetFactorizationCount() == factorizations, L"Load changes should not refactorize!");
+			Assert::IsTrue(TestUtils::IsNear(ring[1]->GetCurrent(), ring[2]->GetCurrent() * 0.2, 1e-6), L"Current did not split by resistance!");
+			ring[1]->SetResistance(0.25);
+			manager->Evaluate(1);
+			Assert::IsTrue(solver->GetFactorizationCount() == factorizations + 1, L"Resistance changes should refactorize!");
+			Assert::IsTrue(TestUtils::IsNear(ring[1]->GetCurrent(), ring[2]->GetCurrent() * 0.5, 1e-6), L"Current did not follow the resistance!");
+
+			Logger::WriteMessage(L"Testing breaking the loop\n");
+			ring[3]->DisconnectChildFromParent(ring[0]);
+			Assert::IsTrue(ring[0]->GetCircuit() == ring[3]->GetCircuit(), L"Buses still connected the other way round should stay in one circuit!");
+			manager->Evaluate(1);
+			Assert::IsTrue(TestUtils::IsNear(ring[1]->GetCurrent(), ring[2]->GetCurrent(), 1e-6), L"All current should take the remaining path!");
+			Assert::IsTrue(TestUtils::IsNear(ring[3]->GetCurrent(), 0, 1e-6), L"No current should flow into the end of the line!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete managers[0];
+			delete managers[1];
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_WarmStartSolveTest)
+			TEST_DESCRIPTION(L"Tests that solves starting from the previously limited sources match the expected distribution and only fall back when the limits change")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_WarmStartSolveTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			PowerBus *bus = manager->CreateBus(10, 1000, 0);
+			PowerSource *sources[3] = { manager->CreateSource(8, 12, 100, 1, 0), manager->CreateSource(8, 12, 200, 1, 0), manager->CreateSource(8, 12, 2000, 1, 0) };
+			for (int i = 0; i < 3; ++i)
+			{
+				bus->ConnectChildToParent(sources[i]);
+			}
+			PowerConsumer *consumer = manager->CreateConsumer(8, 12, 1200, 0);
+			consumer->ConnectChildToParent(bus);
+			consumer->SetConsumerLoad(1);
+			manager->Evaluate(1);
+			PowerCircuit *circuit = bus->GetCircuit();
+
+			Logger::WriteMessage(L"Testing limited sources\n");
+			double total = circuit->GetCircuitCurrent();
+			Assert::IsTrue(TestUtils::IsEqual(sources[0]->GetOutputCurrent(), 10), L"Smallest source should deliver its maximum!");
+			Assert::IsTrue(TestUtils::IsEqual(sources[1]->GetOutputCurrent(), 20), L"Second source should deliver its maximum!");
+			Assert::IsTrue(TestUtils::IsEqual(sources[2]->GetOutputCurrent(), total - 30), L"Largest source should deliver the rest!");
+
+			Logger::WriteMessage(L"Testing small load changes\n");
+			unsigned int coldsolves = circuit->GetColdSolveCount();
+			for (int step = 0; step < 10; ++step)
+			{
+				consumer->SetConsumerLoad(0.9 + step * 0.01);
+				manager->Evaluate(1);
+				total = circuit->GetCircuitCurrent();
+				Assert::IsTrue(TestUtils::IsEqual(sources[0]->GetOutputCurrent() + sources[1]->GetOutputCurrent(), 30), L"Limited sources changed!");
+				Assert::IsTrue(TestUtils::IsEqual(sources[2]->GetOutputCurrent(), total - 30), L"Largest source should deliver the rest!");
+			}
+			Assert::IsTrue(circuit->GetColdSolveCount() == coldsolves, L"Unchanged limits should not be searched for again!");
+
+			Logger::WriteMessage(L"Testing releasing limits\n");
+			consumer->SetConsumerLoad(0.2);
+			manager->Evaluate(1);
+			total = circuit->GetCircuitCurrent();
+			Assert::IsTrue(circuit->GetColdSolveCount() == coldsolves + 1, L"Changed limits should be searched for again!");
+			for (int i = 0; i < 3; ++i)
+			{
+				Assert::IsTrue(TestUtils::IsEqual(sources[i]->GetOutputCurrent(), total / 3), L"Sources should share the load evenly once unlimited!");
+			}
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_SolveMemoizationTest)
+			TEST_DESCRIPTION(L"Tests that a circuit alternating between a few states reuses its solves, and ends up exactly where solving again would")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_SolveMemoizationTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *managers[2] = { new PowerCircuitManager(), new PowerCircuitManager() };
+			managers[1]->SetSolveMemoization(true);
+			PowerBus *buses[2][3];
+			PowerSource *sources[2][2];
+			PowerConsumer *heaters[2];
+			PowerConsumer *strobes[2];
+			for (int m = 0; m < 2; ++m)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					buses[m][i] = managers[m]->CreateBus(10, 1000, 0);
+					PowerConsumer *consumer = managers[m]->CreateConsumer(8, 12, 50, 0);
+					consumer->ConnectChildToParent(buses[m][i]);
+					consumer->SetConsumerLoad(1);
+					if (i > 0)
+					{
+						buses[m][i - 1]->ConnectParentToChild(buses[m][i]);
+					}
+				}
+				sources[m][0] = managers[m]->CreateSource(8, 12, 500, 1, 0);
+				sources[m][1] = managers[m]->CreateSource(8, 12, 300, 2, 0);
+				buses[m][0]->ConnectChildToParent(sources[m][0]);
+				buses[m][2]->ConnectChildToParent(sources[m][1]);
+				heaters[m] = managers[m]->CreateConsumer(8, 12, 200, 0);
+				heaters[m]->ConnectChildToParent(buses[m][1]);
+				strobes[m] = managers[m]->CreateConsumer(8, 12, 30, 0);
+				strobes[m]->ConnectChildToParent(buses[m][2]);
+				managers[m]->Evaluate(1);
+			}
+
+			Logger::WriteMessage(L"Pulsing loads\n");
+			PowerSolveCache *cache = buses[1][0]->GetCircuit()->GetSolveCache();
+			for (int step = 0; step < 24; ++step)
+			{
+				for (int m = 0; m < 2; ++m)
+				{
+					heaters[m]->SetChildSwitchedIn(step % 2 == 0);
+					strobes[m]->SetChildSwitchedIn(step % 3 == 0);
+					managers[m]->Evaluate(1);
+				}
+				for (int i = 0; i < 3; ++i)
+				{
+					Assert::IsTrue(buses[0][i]->GetCurrent() == buses[1][i]->GetCurrent(), L"Reused solve has a different bus current!");
+				}
+				for (int i = 0; i < 2; ++i)
+				{
+					Assert::IsTrue(sources[0][i]->GetOutputCurrent() == sources[1][i]->GetOutputCurrent(), L"Reused solve has a different source current!");
+				}
+			}
+			//the loads go through 4 different states, so only the first 4 steps have to be solved.
+			Assert::IsTrue(cache->GetHitCount() == 20, L"Solves were not reused!");
+
+			Logger::WriteMessage(L"Testing structural changes\n");
+			PowerConsumer *consumer = managers[1]->CreateConsumer(8, 12, 10, 0);
+			consumer->ConnectChildToParent(buses[1][0]);
+			managers[1]->Evaluate(1);
+			Assert::IsTrue(cache->GetHitCount() == 20, L"Solve was reused for a different state!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete managers[0];
+			delete managers[1];
+		}
+
+		BEGIN_TEST_METHOD_ATTRIBUTE(Power_ConverterChainTest)
+			TEST_DESCRIPTION(L"Tests that demand propagates through a chain of converters in a single pass over the circuits")
+		END_TEST_METHOD_ATTRIBUTE()
+
+		TEST_METHOD(Power_ConverterChainTest)
+		{
+			Logger::WriteMessage(L"Creating test assets\n");
+			PowerCircuitManager *manager = new PowerCircuitManager();
+			//400V -> 200V -> 100V -> 50V. The primary circuit is created first, so it comes first in the list of circuits.
+			double voltages[4] = { 400, 200, 100, 50 };
+			PowerBus *buses[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				buses[i] = manager->CreateBus(voltages[i], 1000, 0);
+			}
+			PowerSource *source = manager->CreateSource(380, 420, 100000, 1, 0);
+			buses[0]->ConnectChildToParent(source);
+			PowerConverter *converters[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				converters[i] = manager->CreateConverter(40, 420, 100000, 0.9, 1, 0);
+				buses[i]->ConnectParentToChild(converters[i]);
+				buses[i + 1]->ConnectChildToParent(converters[i]);
+			}
+			PowerConsumer *consumer = manager->CreateConsumer(40, 60, 500, 0);
+			consumer->ConnectChildToParent(buses[3]);
+			consumer->SetConsumerLoad(1);
+			manager->Evaluate(1);
+
+			Logger::WriteMessage(L"Testing demand propagation\n");
+			Assert::IsTrue(manager->GetLastEvaluationPassCount() == 1, L"Demand should reach the primary circuit in one pass!");
+			Assert::IsTrue(TestUtils::IsEqual(source->GetCurrentPowerOutput(), 500 / (0.9 * 0.9 * 0.9)), L"Incorrect amount of power drawn from source!");
+			Assert::IsTrue(TestUtils::IsEqual(converters[0]->GetInputCurrentForOutput(converters[0]->GetOutputCurrent()), converters[0]->GetInputCurrent()), L"Converter draws the wrong input current!");
+
+			consumer->SetConsumerLoad(0.5);
+			manager->Evaluate(1);
+			Assert::IsTrue(manager->GetLastEvaluationPassCount() == 1, L"Demand should reach the primary circuit in one pass!");
+			Assert::IsTrue(TestUtils::IsEqual(source->GetCurrentPowerOutput(), 250 / (0.9 * 0.9 * 0.9)), L"Incorrect amount of power drawn from source after load change!");
+
+			Logger::WriteMessage(L"cleaning up test assets\n");
+			delete manager;
+		}
 	};
 }
\ No newline at end of file
@@ -28,3 +28,33 @@ private:
 	static string message;
 };
 
+
+/**
+ * \brief Memory resource that forwards to the heap, but counts what passes through it.
+ */
+class CountingMemoryResource : public pmr::memory_resource
+{
+public:
+	unsigned int allocations = 0;
+	long long outstanding = 0;				//!< Bytes allocated and not yet deallocated.
+
+protected:
+	void *do_allocate(size_t bytes, size_t alignment) override
+	{
+		allocations++;
+		outstanding += bytes;
+		return pmr::new_delete_resource()->allocate(bytes, alignment);
+	}
+
+	void do_deallocate(void *p, size_t bytes, size_t alignment) override
+	{
+		outstanding -= bytes;
+		pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+	}
+
+	bool do_is_equal(const pmr::memory_resource &other) const noexcept override
+	{
+		return this == &other;
+	}
+};
+
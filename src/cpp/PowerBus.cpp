@@ -6,59 +6,90 @@
 #include "PowerConsumer.h"
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
-#include "PowerSubCircuit.h"
 #include "PowerCircuitManager.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
+#include "PowerElementRegistry.h"
 
 
 
 PowerBus::PowerBus(double voltage, double maxamps, PowerCircuitManager *circuitmanager, unsigned int location_id)
-	: PowerChild(POWERCHILD_TYPE::PCT_BUS, voltage, voltage, false), PowerParent(POWERPARENT_TYPE::PPT_BUS, voltage, voltage, false), maxcurrent(maxamps), locationid(location_id), circuitmanager(circuitmanager)
+	: PowerChild(POWERCHILD_TYPE::PCT_BUS, voltage, voltage, false, getMemoryResource(circuitmanager)), PowerParent(POWERPARENT_TYPE::PPT_BUS, voltage, voltage, false, getMemoryResource(circuitmanager)),
+	  circuitmanager(circuitmanager), locationid(location_id)
 {
-	outputvoltage.current = voltage;
-	inputvoltage.current = voltage;
+	busstate = PowerStateTable<BUS_SOLVER_STATE>::Get().Allocate();
+	childstate = &busstate->child;
+	parentstate = &busstate->parent;
+	busstate->maxcurrent = maxamps;
+	parentstate->voltage = voltage;
+	childstate->voltage = voltage;
+	if (circuitmanager != NULL)
+	{
+		circuitmanager->GetRegistry()->registerElement(this, this);
+	}
 }
 
 
 PowerBus::~PowerBus()
 {
+	PowerStateTable<BUS_SOLVER_STATE>::Get().Free(busstate);
+}
 
+
+pmr::memory_resource *PowerBus::getMemoryResource(PowerCircuitManager *circuitmanager)
+{
+	return circuitmanager != NULL ? circuitmanager->GetMemoryResource() : pmr::get_default_resource();
 }
 
 
 double PowerBus::GetEquivalentResistance()
 {
-	return equivalent_resistance;
+	return busstate->equivalentresistance;
 }
 
 
 double PowerBus::GetCurrent()
 {
-	return throughcurrent;
+	return busstate->current;
 }
 
 
 double PowerBus::GetMaxCurrent()
 {
-	return maxcurrent;
+	return busstate->maxcurrent;
 }
 
 
 void PowerBus::SetCurrent(double amps)
 {
-	throughcurrent = amps;
+	busstate->current = amps;
 }
 
 
 void PowerBus::SetMaxCurrent(double amps)
 {
-	maxcurrent = amps;
+	busstate->maxcurrent = amps;
+}
+
+
+void PowerBus::SetResistance(double ohms)
+{
+	if (ohms != busstate->resistance)
+	{
+		busstate->resistance = ohms;
+		if (parentstate->circuit != NULL)
+		{
+			parentstate->circuit->RegisterStateChange();
+		}
+	}
 }
 
 
 void PowerBus::Evaluate(double deltatime)
 {
 	//check if the state of any children of this object has changed at all.
-	if (child_state_changed)
+	if (parentstate->childstatechanged)
 	{
 		double new_eq_resistance = 0;
 		for (auto i = children.begin(); i != children.end(); ++i)
@@ -72,14 +103,16 @@ void PowerBus::Evaluate(double deltatime)
 				((PowerConsumer*)(*i))->SetRunning(true);
 			}
 		}
-		equivalent_resistance = 1 / new_eq_resistance;
+		busstate->equivalentresistance = 1 / new_eq_resistance;
 		RegisterChildStateChange();
-		child_state_changed = false;
+		parentstate->childstatechanged = false;
 	}
 }
 
 void PowerBus::ConnectParentToChild(PowerChild *child, bool bidirectional)
 {
+	//buses are where elements meet a manager. Consumers have no other way of getting there.
+	circuitmanager->GetRegistry()->registerElement(child, dynamic_cast<PowerParent*>(child));
 	PowerParent::ConnectParentToChild(child, bidirectional);
 
 	if (!bidirectional && child->GetChildType() == PCT_BUS &&
@@ -92,9 +125,11 @@ void PowerBus::ConnectParentToChild(PowerChild *child, bool bidirectional)
 
 void PowerBus::ConnectChildToParent(PowerParent *parent, bool bidirectional)
 {
+	circuitmanager->GetRegistry()->registerElement(dynamic_cast<PowerChild*>(parent), parent);
+
 	//when a bus gets connected as a child, it is its job to either integrate into the circuit of the parent,
 	//or, if the parent isn't yet a member of a circuit, create one and integrate the parent into it.
-	if (circuit == NULL)
+	if (parentstate->circuit == NULL)
 	{
 		//this isn't in a circuit yet, is the parent?
 		PowerCircuit *newcircuit = parent->GetCircuit();
@@ -109,22 +144,27 @@ void PowerBus::ConnectChildToParent(PowerParent *parent, bool bidirectional)
 			//parent is in a circuit, but this isn't. integrate into parent circuit.
 			newcircuit->AddPowerBus(this);
 		}
-		circuit = newcircuit;
+		parentstate->circuit = newcircuit;
 	}
-	else if (circuit != parent->GetCircuit())
+	else if (parentstate->circuit != parent->GetCircuit())
 	{
 		//this is already part of a circuit, and it's not the same as the parents. But what if the parent is already part of another circuit?
 		if (parent->GetCircuit() != NULL)
 		{
 			//integrate this circuit into the parents circuit
-			circuitmanager->MergeCircuits(parent->GetCircuit(), circuit);
+			circuitmanager->MergeCircuits(parent->GetCircuit(), parentstate->circuit);
 		}
 		else
 		{
 			//the parent doesn't have a circuit yet, so integrate it into this one.
-			circuit->AddPowerParent(parent);
+			parentstate->circuit->AddPowerParent(parent);
 		}
 	}
+	else
+	{
+		//both are already in the same circuit, so this closes a loop.
+		parentstate->circuit->RegisterStructureChange();
+	}
 	//connect the darn things already!
 	PowerChild::ConnectChildToParent(parent, bidirectional);
 
@@ -150,10 +190,10 @@ void PowerBus::DisconnectChildFromParent(PowerParent *parent, bool bidirectional
 		DisconnectParentFromChild((PowerBus*)parent, true);
 	}
 
-	if (circuit == parent->GetCircuit())
+	if (parentstate->circuit == parent->GetCircuit())
 	{
 		//at this point, all relations are resolved, and we have to move this bus and everything connected to it to a new circuit.
-		circuitmanager->SplitCircuit(circuit, this, parent);
+		circuitmanager->SplitCircuit(parentstate->circuit, this, parent);
 	}
 	
 }
@@ -164,24 +204,6 @@ void PowerBus::DisconnectParentFromChild(PowerChild *child, bool bidirectional)
 }
 
 
-void PowerBus::RebuildFeedingSubcircuits()
-{
-	//destroy all subcircuits.
-	for (auto i = feeding_subcircuits.begin(); i != feeding_subcircuits.end(); ++i)
-	{
-		delete (*i);
-	}
-
-	feeding_subcircuits.clear();
-
-	//construct a subcircuit for every parent.
-	for (auto i = parents.begin(); i != parents.end(); ++i)
-	{
-		feeding_subcircuits.push_back(new PowerSubCircuit((*i), this));
-	}
-}
-
-
 PowerCircuitManager *PowerBus::GetCircuitManager()
 {
 	return circuitmanager;
@@ -202,7 +224,9 @@ bool PowerBus::CanConnectToParent(PowerParent *parent, bool bidirectional)
 	//a Bus can always connect to a parent that gives its ok,
 	//provided it is not trying to connect to an element in the same circuit.
 	//this avoidance of circular connections makes the computations in the circuit a lot easier!
-	if (parent->GetCircuit() != circuit || circuit == NULL)
+	//The nodal solver doesn't care about loops, though.
+	if (parent->GetCircuit() != parentstate->circuit || parentstate->circuit == NULL ||
+		(circuitmanager != NULL && circuitmanager->IsNodalSolverEnabled()))
 	{
 		return PowerChild::CanConnectToParent(parent, bidirectional);
 	}
@@ -212,8 +236,7 @@ bool PowerBus::CanConnectToParent(PowerParent *parent, bool bidirectional)
 
 double PowerBus::GetChildResistance()
 {
-	//the own resistance of a bus is always zero.
-	return 0.0;
+	return busstate->resistance;
 }
 
 
@@ -291,18 +314,51 @@ bool PowerBus::IsGlobal()
 }
 
 
-void PowerBus::CalculateTotalCurrentFlow(double deltatime)
+void PowerBus::SetTotalCurrentFlow(double amps)
 {
-	double oldcurrent = throughcurrent;
-	//the current flowing through this bus is really just the current surplus of all feeding subcircuits.
-	throughcurrent = 0;
-	for (auto i = feeding_subcircuits.begin(); i != feeding_subcircuits.end(); ++i)
+	double oldcurrent = busstate->current;
+	busstate->current = amps;
+	if (busstate->current != oldcurrent)
 	{
-		(*i)->Evaluate(deltatime);
-		throughcurrent += (*i)->GetCurrentSurplus();
+		PowerEventQueue *eventqueue = circuitmanager != NULL ? circuitmanager->GetEventQueue() : NULL;
+		if (eventqueue != NULL)
+		{
+			eventqueue->Raise(PEVT_BUS_CURRENT, this, oldcurrent);
+		}
+		else
+		{
+			fireCurrentEvents(oldcurrent);
+		}
 	}
-	if (currentThroughputChanged != NULL && throughcurrent != oldcurrent) currentThroughputChanged(this);
-	if (maxCurrentHigh != NULL && oldcurrent <= maxcurrent && throughcurrent > maxcurrent) maxCurrentHigh(this);
-	if (maxCurrentOk != NULL && oldcurrent > maxcurrent && throughcurrent <= maxcurrent) maxCurrentOk(this);
 }
 
+
+void PowerBus::fireCurrentEvents(double oldcurrent)
+{
+	if (parentsubscriptions == NULL)
+	{
+		return;
+	}
+	if (busstate->current != oldcurrent) parentsubscriptions->currentchanged.Invoke(this);
+	if (oldcurrent <= busstate->maxcurrent && busstate->current > busstate->maxcurrent) parentsubscriptions->maxcurrenthigh.Invoke(this);
+	if (oldcurrent > busstate->maxcurrent && busstate->current <= busstate->maxcurrent) parentsubscriptions->maxcurrentok.Invoke(this);
+}
+
+
+unsigned int PowerBus::OnCurrentThroughputChange(function<void(PowerBus*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->currentchanged, lambda);
+}
+
+unsigned int PowerBus::OnMaxCurrentHigh(function<void(PowerBus*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->maxcurrenthigh, lambda);
+}
+
+unsigned int PowerBus::OnMaxCurrentOk(function<void(PowerBus*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->maxcurrentok, lambda);
+}
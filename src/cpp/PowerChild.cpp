@@ -2,28 +2,44 @@
 #include "PowerTypes.h"
 #include "PowerParent.h"
 #include "PowerChild.h"
-
-PowerChild::PowerChild(POWERCHILD_TYPE type, double minvoltage, double maxvoltage, bool switchable)
-	: childtype(type), childcanswitch(switchable)
+#include "PowerCircuit_Base.h"
+#include "PowerCircuit.h"
+#include "PowerCircuitManager.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
+#include "PowerElementRegistry.h"
+
+PowerChild::PowerChild(POWERCHILD_TYPE type, double minvoltage, double maxvoltage, bool switchable, pmr::memory_resource *resource)
+	: parents(resource), childtype(type), childcanswitch(switchable)
 {
-	inputvoltage.minimum = minvoltage;
-	inputvoltage.maximum = maxvoltage;
+	inputvoltagerange.minimum = minvoltage;
+	inputvoltagerange.maximum = maxvoltage;
 }
 
 
 PowerChild::~PowerChild()
 {
-
+	if (registry != NULL)
+	{
+		registry->unregisterElement(handle);
+	}
+	delete childsubscriptions;
 }
 
 void PowerChild::GetParents(vector<PowerParent*> &OUT_parents)
 {
-	OUT_parents = parents;
+	OUT_parents.assign(parents.begin(), parents.end());
+}
+
+PowerSpan<PowerParent*> PowerChild::GetParents()
+{
+	return PowerSpan<PowerParent*>(parents.begin(), parents.size());
 }
 
 bool PowerChild::IsChildSwitchedIn() 
 { 
-	return childswitchedin; 
+	return childstate->switchedin; 
 }
 
 bool PowerChild::IsChildSwitchable()
@@ -33,23 +49,38 @@ bool PowerChild::IsChildSwitchable()
 
 void PowerChild::SetChildSwitchedIn(bool switchedin) 
 { 
-	if (childcanswitch && switchedin != childswitchedin)
+	if (childcanswitch && switchedin != childstate->switchedin)
 	{
-		childswitchedin = switchedin;
+		bool wasswitchedin = childstate->switchedin;
+		childstate->switchedin = switchedin;
 		registerStateChangeWithParents();
-		if (childSwitchIn && switchedin) childSwitchIn(this);
-		else if (childSwitchOut && !switchedin) childSwitchOut(this);
+		raiseChildSwitchEvent(wasswitchedin);
+	}
+}
+
+void PowerChild::raiseChildSwitchEvent(bool wasswitchedin)
+{
+	PowerEventQueue *eventqueue = getEventQueue();
+	if (eventqueue != NULL)
+	{
+		eventqueue->Raise(PEVT_CHILD_SWITCH, this, wasswitchedin);
+	}
+	else
+	{
+		fireChildSwitchEvent(wasswitchedin);
 	}
 }
 
 VOLTAGE_INFO PowerChild::GetInputVoltageInfo()
 {
+	VOLTAGE_INFO inputvoltage = inputvoltagerange;
+	inputvoltage.current = childstate->voltage;
 	return inputvoltage;
 }
 
 double PowerChild::GetCurrentInputVoltage()
 {
-	return inputvoltage.current;
+	return childstate->voltage;
 }
 
 
@@ -102,3 +133,59 @@ void PowerChild::DisconnectChildFromParent(PowerParent *parent, bool bidirection
 		parent->DisconnectParentFromChild(this, false);
 	}
 }
+
+
+PowerEventQueue *PowerChild::getEventQueue()
+{
+	//children don't know their circuit, but any parent that is part of one does.
+	for (auto i = parents.begin(); i != parents.end(); ++i)
+	{
+		if ((*i)->GetCircuit() != NULL)
+		{
+			return (*i)->GetCircuit()->GetCircuitManager()->GetEventQueue();
+		}
+	}
+	return NULL;
+}
+
+void PowerChild::fireChildSwitchEvent(bool wasswitchedin)
+{
+	if (childstate->switchedin == wasswitchedin)
+	{
+		return;
+	}
+	if (childsubscriptions == NULL)
+	{
+		return;
+	}
+	if (childstate->switchedin) childsubscriptions->switchin.Invoke(this);
+	else childsubscriptions->switchout.Invoke(this);
+}
+
+
+unsigned int PowerChild::OnChildSwitchIn(function<void(PowerChild*)> lambda)
+{
+	CHILD_SUBSCRIPTIONS *subscriptions = getChildSubscriptions();
+	return subscriptions->Add(subscriptions->switchin, lambda);
+}
+
+unsigned int PowerChild::OnChildSwitchOut(function<void(PowerChild*)> lambda)
+{
+	CHILD_SUBSCRIPTIONS *subscriptions = getChildSubscriptions();
+	return subscriptions->Add(subscriptions->switchout, lambda);
+}
+
+
+bool PowerChild::RemoveChildEventHandler(unsigned int id)
+{
+	return childsubscriptions != NULL && childsubscriptions->Remove(id);
+}
+
+CHILD_SUBSCRIPTIONS *PowerChild::getChildSubscriptions()
+{
+	if (childsubscriptions == NULL)
+	{
+		childsubscriptions = new CHILD_SUBSCRIPTIONS;
+	}
+	return childsubscriptions;
+}
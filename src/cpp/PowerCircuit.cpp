@@ -7,15 +7,33 @@
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
 #include "PowerCircuitManager.h"
+#include "PowerTopologyBuilder.h"
+#include "PowerReachabilityTable.h"
+#include "PowerNodalSolver.h"
+#include "PowerSolveCache.h"
+#include <unordered_map>
 
 PowerCircuit::PowerCircuit(PowerBus *initialbus)
-	: PowerCircuit_Base(initialbus->GetCurrentOutputVoltage())
+	: PowerCircuit_Base(initialbus->GetCurrentOutputVoltage(), initialbus->GetCircuitManager()->GetMemoryResource()), manager(initialbus->GetCircuitManager()),
+	  limitedsources(initialbus->GetCircuitManager()->GetMemoryResource())
 {
+	pmr::memory_resource *resource = powerbuses.get_allocator().resource();
+	reachability = new (resource->allocate(sizeof(PowerReachabilityTable), alignof(PowerReachabilityTable))) PowerReachabilityTable(resource);
+	nodalsolver = new (resource->allocate(sizeof(PowerNodalSolver), alignof(PowerNodalSolver))) PowerNodalSolver(resource);
+	solvecache = new (resource->allocate(sizeof(PowerSolveCache), alignof(PowerSolveCache))) PowerSolveCache(resource);
 	AddPowerBus(initialbus);
 }
 
 PowerCircuit::~PowerCircuit()
 {
+	pmr::memory_resource *resource = powerbuses.get_allocator().resource();
+	reachability->~PowerReachabilityTable();
+	resource->deallocate(reachability, sizeof(PowerReachabilityTable), alignof(PowerReachabilityTable));
+	nodalsolver->~PowerNodalSolver();
+	resource->deallocate(nodalsolver, sizeof(PowerNodalSolver), alignof(PowerNodalSolver));
+	solvecache->~PowerSolveCache();
+	resource->deallocate(solvecache, sizeof(PowerSolveCache), alignof(PowerSolveCache));
+
 	//if there are any members left, remove them.
 	for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
 	{
@@ -54,6 +72,11 @@ void PowerCircuit::AddPowerBus(PowerBus *bus)
 void PowerCircuit::RemovePowerSource(PowerSource *source)
 {
 	PowerCircuit_Base::RemovePowerSource(source);
+	auto limited = lower_bound(limitedsources.begin(), limitedsources.end(), source);
+	if (limited != limitedsources.end() && (*limited) == source)
+	{
+		limitedsources.erase(limited);
+	}
 	source->SetCircuitToNull();
 	structurechanged = true;
 }
@@ -81,13 +104,31 @@ double PowerCircuit::GetEquivalentResistance()
 void PowerCircuit::Evaluate(double deltatime)
 {
 	circuit_current_demand_change = 0;
+	evaluatedpass = manager->evaluationpass;
 
 	if (structurechanged)
 	{
-		//the circuits structure has changed since the last evaluation. This means rebuilding the feeding subcircuits for all buses.
+		//the circuits structure has changed since the last evaluation. This means rebuilding the reachability of all buses.
 		structurechanged = false;
 		statechange = true;
-		rebuildAllSubCircuits();
+		//earlier solves index sources and buses by their position, which might have changed.
+		solvecache->Clear();
+		PowerTopologyBuilder *builder = manager->GetTopologyBuilder();
+		if (manager->IsNodalSolverEnabled())
+		{
+			//the analysis is needed right away, so it's never handed to the builder.
+			rebuildNodalSolver();
+		}
+		else if (builder != NULL)
+		{
+			//let the builder do the work on its own thread. Until it's done, evaluation continues with the old reachability.
+			topologystamp = manager->createTopologyStamp();
+			builder->Submit(createTopologySnapshot());
+		}
+		else
+		{
+			rebuildReachability();
+		}
 	}
 
 	if (statechange)
@@ -98,17 +139,49 @@ void PowerCircuit::Evaluate(double deltatime)
 			(*i)->Evaluate(deltatime);
 		}
 
-		//calculate equivalent resistance of the circuit and the current we actually need.
-		calculateEquivalentResistance();
-		total_circuit_current = voltage / equivalent_resistance;
-		distributeCurrentDraw();
+		//the solve only depends on the state of buses and sources. If the circuit was in the same state recently, there's no need to solve it again.
+		SOLVE_CACHE_ENTRY *solve = NULL;
+		if (manager->IsSolveMemoizationEnabled())
+		{
+			buildSolveKey();
+			solve = solvecache->Find();
+		}
 
-		//finally, tell the buses to calculate the total current flowing through them.
-		//this must be done even if their state did not change, as any change anywhere
-		//in the circuit has the potential to influence the current flowing through any bus.
-		for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
+		if (solve != NULL)
 		{
-			(*i)->CalculateTotalCurrentFlow(deltatime);
+			applySolve(solve);
+		}
+		else
+		{
+			//calculate equivalent resistance of the circuit and the current we actually need.
+			calculateEquivalentResistance();
+			total_circuit_current = voltage / equivalent_resistance;
+			distributeCurrentDraw();
+
+			//finally, tell the buses the total current flowing through them.
+			//this must be done even if their state did not change, as any change anywhere
+			//in the circuit has the potential to influence the current flowing through any bus.
+			if (manager->IsNodalSolverEnabled())
+			{
+				nodalsolver->Update(voltage);
+				for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
+				{
+					(*i)->SetTotalCurrentFlow(nodalsolver->GetThroughCurrent((*i)));
+				}
+			}
+			else
+			{
+				reachability->Update();
+				for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
+				{
+					(*i)->SetTotalCurrentFlow(reachability->GetThroughCurrent((*i)));
+				}
+			}
+
+			if (manager->IsSolveMemoizationEnabled() && !solvechangedstate)
+			{
+				storeSolve();
+			}
 		}
 
 		statechange = false;
@@ -140,8 +213,12 @@ void PowerCircuit::distributeCurrentDraw(bool force)
 {
 
 	//walk through the powersources and see which ones are providing power
+	solvechangedstate = false;
 	double total_available_current = 0;
-	vector<POWERSOURCE_STATS*> involved_sources;        //will keep track of the powersources involved in feeding the circuit.
+	pmr::memory_resource *resource = powersources.get_allocator().resource();
+	pmr::vector<POWERSOURCE_STATS> stats(resource);
+	stats.reserve(powersources.size());					//every source appears at most once, so this never reallocates under the pointers below.
+	pmr::vector<POWERSOURCE_STATS*> involved_sources(resource);        //will keep track of the powersources involved in feeding the circuit.
 	for (unsigned int i = 0; i < powersources.size(); ++i)
 	{
 		if (powersources[i]->IsParentSwitchedIn())
@@ -150,10 +227,12 @@ void PowerCircuit::distributeCurrentDraw(bool force)
 			if (total_available_current >= total_circuit_current && powersources[i]->IsAutoswitchEnabled())
 			{
 				powersources[i]->SetParentSwitchedIn(false);
+				solvechangedstate = true;
 			}
 			else
 			{
-				involved_sources.push_back(new POWERSOURCE_STATS(powersources[i], force));
+				stats.emplace_back(powersources[i], force);
+				involved_sources.push_back(&stats.back());
 				total_available_current += involved_sources.back()->maxcurrent;
 			}
 		}
@@ -162,28 +241,41 @@ void PowerCircuit::distributeCurrentDraw(bool force)
 	if (total_available_current < total_circuit_current)
 	{
 		//We don't have enough power! Switch in sources that are on standby!
-		double missing_current = switchInPowerSourcesOnStandby(involved_sources, total_circuit_current - total_available_current);
+		double missing_current = switchInPowerSourcesOnStandby(stats, involved_sources, total_circuit_current - total_available_current);
 		if (missing_current > 0)
 		{
 			//we switched in all the sources we are allowed to, but we still don't have enough current! Some things will have to go!
 			reduceCircuitCurrentBy(missing_current);
+			solvechangedstate = true;
 			total_circuit_current = total_available_current;
 		}
 	}
 	//Now the circuit is stable and able to provide enough current for anything still running.
 	//calculate how much every powersource will provide, and sort out all sources that are not limited by their maximum output
-	calculateCurrentDraw(involved_sources, total_circuit_current, force);
+	if (!calculateCurrentDrawFromLastLimits(involved_sources, total_circuit_current))
+	{
+		coldsolves++;
+		calculateCurrentDraw(involved_sources, total_circuit_current, force);
+	}
+	limitedsources.clear();
+	for (auto i = involved_sources.begin(); i != involved_sources.end(); ++i)
+	{
+		if ((*i)->limited)
+		{
+			limitedsources.push_back((*i)->psource);
+		}
+	}
+	sort(limitedsources.begin(), limitedsources.end());
 
-	//apply changes to powersources and deallocate the stats.
+	//apply changes to powersources.
 	for (unsigned int i = 0; i < involved_sources.size(); ++i)
 	{
 		involved_sources[i]->Apply();
-		delete involved_sources[i];
 	}
 }
 
 
-double PowerCircuit::switchInPowerSourcesOnStandby(vector<POWERSOURCE_STATS*> &IN_OUT_involved_sources, double missing_current)
+double PowerCircuit::switchInPowerSourcesOnStandby(pmr::vector<POWERSOURCE_STATS> &IN_OUT_stats, pmr::vector<POWERSOURCE_STATS*> &IN_OUT_involved_sources, double missing_current)
 {
 	for (unsigned int i = 0; i < powersources.size(); ++i)
 	{
@@ -195,7 +287,9 @@ double PowerCircuit::switchInPowerSourcesOnStandby(vector<POWERSOURCE_STATS*> &I
 			{
 				//the powersource is on standby, switch it in and see how much current it provides.
 				powersources[i]->SetParentSwitchedIn(true);
-				IN_OUT_involved_sources.push_back(new POWERSOURCE_STATS(powersources[i], true));
+				solvechangedstate = true;
+				IN_OUT_stats.emplace_back(powersources[i], true);
+				IN_OUT_involved_sources.push_back(&IN_OUT_stats.back());
 				missing_current -= IN_OUT_involved_sources.back()->maxcurrent;
 			}
 		}
@@ -222,8 +316,10 @@ void PowerCircuit::reduceCircuitCurrentBy(double missing_current)
 }
 
 
-void PowerCircuit::calculateCurrentDraw(vector<POWERSOURCE_STATS*> non_limited_sources, double required_current, bool force)
+void PowerCircuit::calculateCurrentDraw(const pmr::vector<POWERSOURCE_STATS*> &sources, double required_current, bool force)
 {
+	//work on a copy, limited sources are taken out of it. The copy would otherwise end up on the default resource.
+	pmr::vector<POWERSOURCE_STATS*> non_limited_sources(sources, sources.get_allocator());
 	double sum_eq_resistances = getSumOfEquivalentResistances(non_limited_sources);
 
 	//calculate current drawn from each source and immediately get rid of those that hit limit
@@ -249,7 +345,46 @@ void PowerCircuit::calculateCurrentDraw(vector<POWERSOURCE_STATS*> non_limited_s
 
 
 
-double PowerCircuit::getSumOfEquivalentResistances(vector<POWERSOURCE_STATS*> &involved_sources)
+bool PowerCircuit::calculateCurrentDrawFromLastLimits(const pmr::vector<POWERSOURCE_STATS*> &sources, double required_current)
+{
+	//limited sources deliver their maximum, the rest is shared by the others.
+	double limited_current = 0;
+	double sum_eq_resistances = 0;
+	for (auto i = sources.begin(); i != sources.end(); ++i)
+	{
+		if (binary_search(limitedsources.begin(), limitedsources.end(), (*i)->psource))
+		{
+			limited_current += (*i)->maxcurrent;
+		}
+		else
+		{
+			sum_eq_resistances += 1 / (*i)->baseresistance;
+		}
+	}
+	if (sum_eq_resistances == 0)
+	{
+		return false;
+	}
+
+	//check that every source is limited exactly if it was last time before changing anything.
+	double shared_current = (required_current - limited_current) / sum_eq_resistances;
+	for (auto i = sources.begin(); i != sources.end(); ++i)
+	{
+		bool waslimited = binary_search(limitedsources.begin(), limitedsources.end(), (*i)->psource);
+		if ((shared_current / (*i)->baseresistance > (*i)->maxcurrent) != waslimited)
+		{
+			return false;
+		}
+	}
+	for (auto i = sources.begin(); i != sources.end(); ++i)
+	{
+		(*i)->SetRequestedCurrent(shared_current / (*i)->baseresistance);
+	}
+	return true;
+}
+
+
+double PowerCircuit::getSumOfEquivalentResistances(pmr::vector<POWERSOURCE_STATS*> &involved_sources)
 {
 	double sum_eq_resistances = 0;
 	for (auto i = involved_sources.begin(); i != involved_sources.end(); ++i)
@@ -260,12 +395,80 @@ double PowerCircuit::getSumOfEquivalentResistances(vector<POWERSOURCE_STATS*> &i
 }
 
 
-void PowerCircuit::rebuildAllSubCircuits()
+void PowerCircuit::buildSolveKey()
+{
+	pmr::vector<double> &key = solvecache->BeginKey();
+	key.reserve(powerbuses.size() * 2 + powersources.size() * 4);
+	for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
+	{
+		key.push_back((*i)->GetEquivalentResistance());
+		key.push_back((*i)->GetChildResistance());
+	}
+	for (auto i = powersources.begin(); i != powersources.end(); ++i)
+	{
+		key.push_back((*i)->IsParentSwitchedIn() ? 1 : 0);
+		key.push_back((*i)->IsAutoswitchEnabled() ? 1 : 0);
+		key.push_back((*i)->GetMaxOutputCurrent(true));
+		key.push_back((*i)->GetInternalResistance());
+	}
+}
+
+
+void PowerCircuit::storeSolve()
 {
+	SOLVE_CACHE_ENTRY *solve = solvecache->Store();
+	solve->equivalentresistance = equivalent_resistance;
+	solve->circuitcurrent = total_circuit_current;
+	solve->sourcecurrents.clear();
+	for (auto i = powersources.begin(); i != powersources.end(); ++i)
+	{
+		//only switched in sources were involved, the others kept whatever output they had.
+		solve->sourcecurrents.push_back((*i)->IsParentSwitchedIn() ? (*i)->GetOutputCurrent() : -1);
+	}
+	solve->buscurrents.clear();
 	for (auto i = powerbuses.begin(); i != powerbuses.end(); ++i)
 	{
-		(*i)->RebuildFeedingSubcircuits();
+		solve->buscurrents.push_back((*i)->GetCurrent());
 	}
+	solve->limitedsources.assign(limitedsources.begin(), limitedsources.end());
+}
+
+
+void PowerCircuit::applySolve(SOLVE_CACHE_ENTRY *solve)
+{
+	equivalent_resistance = solve->equivalentresistance;
+	total_circuit_current = solve->circuitcurrent;
+	for (unsigned int i = 0; i < powersources.size(); ++i)
+	{
+		if (solve->sourcecurrents[i] >= 0)
+		{
+			powersources[i]->SetRequestedCurrent(solve->sourcecurrents[i]);
+		}
+	}
+	//the reachability table notices the changed sources and buses by their generation the next time it is updated.
+	for (unsigned int i = 0; i < powerbuses.size(); ++i)
+	{
+		powerbuses[i]->SetTotalCurrentFlow(solve->buscurrents[i]);
+	}
+	limitedsources.assign(solve->limitedsources.begin(), solve->limitedsources.end());
+}
+
+
+void PowerCircuit::rebuildReachability()
+{
+	TOPOLOGY_SNAPSHOT *snapshot = createTopologySnapshot();
+	TOPOLOGY_RESULT *result = PowerTopologyBuilder::Build(snapshot);
+	applyTopology(result);
+	delete result;
+	delete snapshot;
+}
+
+
+void PowerCircuit::rebuildNodalSolver()
+{
+	TOPOLOGY_SNAPSHOT *snapshot = createTopologySnapshot();
+	nodalsolver->Analyze(snapshot);
+	delete snapshot;
 }
 
 
@@ -287,6 +490,91 @@ double PowerCircuit::GetMaximumSurplusCurrent()
 void PowerCircuit::RegisterCrossCircuitCurrentDemandChange(double amps)
 {
 	circuit_current_demand_change += amps;
-	//inform the circuit manager that it will have to rerun the evaluation.
-	powerbuses[0]->GetCircuitManager()->RegisterAlreadyEvaluatedCircuitChange();
+	if (evaluatedpass == manager->evaluationpass)
+	{
+		//this circuit was already evaluated in this pass. Inform the circuit manager that it will have to rerun the evaluation.
+		//Otherwise, the change is picked up when it's this circuits turn.
+		manager->RegisterAlreadyEvaluatedCircuitChange();
+	}
+}
+
+
+PowerCircuitManager *PowerCircuit::GetCircuitManager()
+{
+	return manager;
+}
+
+
+PowerReachabilityTable *PowerCircuit::GetReachabilityTable()
+{
+	return reachability;
+}
+
+
+unsigned int PowerCircuit::GetColdSolveCount()
+{
+	return coldsolves;
+}
+
+
+PowerSolveCache *PowerCircuit::GetSolveCache()
+{
+	return solvecache;
+}
+
+
+PowerNodalSolver *PowerCircuit::GetNodalSolver()
+{
+	return nodalsolver;
+}
+
+
+void PowerCircuit::RegisterStructureChange()
+{
+	structurechanged = true;
+}
+
+
+TOPOLOGY_SNAPSHOT *PowerCircuit::createTopologySnapshot()
+{
+	TOPOLOGY_SNAPSHOT *snapshot = new TOPOLOGY_SNAPSHOT;
+	snapshot->circuit = this;
+	snapshot->topologystamp = topologystamp;
+	snapshot->reduce = manager->IsTopologyReductionEnabled();
+	snapshot->sources.assign(powersources.begin(), powersources.end());
+	snapshot->buses.assign(powerbuses.begin(), powerbuses.end());
+
+	pmr::unordered_map<PowerParent*, unsigned int> elementindices(powerbuses.get_allocator().resource());
+	for (unsigned int i = 0; i < powersources.size(); ++i)
+	{
+		elementindices[powersources[i]] = i;
+	}
+	for (unsigned int i = 0; i < powerbuses.size(); ++i)
+	{
+		elementindices[powerbuses[i]] = powersources.size() + i;
+	}
+
+	snapshot->parentoffsets.reserve(powerbuses.size() + 1);
+	for (unsigned int i = 0; i < powerbuses.size(); ++i)
+	{
+		snapshot->parentoffsets.push_back(snapshot->parents.size());
+		PowerSpan<PowerParent*> parents = powerbuses[i]->GetParents();
+		for (auto parent = parents.begin(); parent != parents.end(); ++parent)
+		{
+			assert(elementindices.find((*parent)) != elementindices.end() && "Bus is fed by an element outside its circuit!");
+			snapshot->parents.push_back(elementindices[(*parent)]);
+		}
+	}
+	snapshot->parentoffsets.push_back(snapshot->parents.size());
+	return snapshot;
+}
+
+
+void PowerCircuit::applyTopology(TOPOLOGY_RESULT *result)
+{
+	reachability->Assign(result, voltage);
+	//earlier solves were distributed with the old reachability.
+	solvecache->Clear();
+	//the through-currents of all buses have to be recalculated with the new reachability.
+	statechange = true;
 }
@@ -3,21 +3,60 @@
 #include "PowerChild.h"
 #include "PowerParent.h"
 #include "PowerSource.h"
+#include "PowerConsumer.h"
+#include "PowerSourceChargable.h"
+#include "PowerConverter.h"
 #include "PowerBus.h"
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
 #include "PowerCircuitManager.h"
+#include "PowerTopologyBuilder.h"
+#include "PowerSolveCache.h"
+#include "PowerStateBuffer.h"
+#include "PowerCommandQueue.h"
+#include "PowerEventQueue.h"
+#include "PowerEventStream.h"
+#include "PowerElementRegistry.h"
+#include "PowerElementPool.h"
+#include "PowerSolverState.h"
+#include <unordered_map>
 #include <queue>
 #include <set>
 
 
-PowerCircuitManager::PowerCircuitManager()
+PowerCircuitManager::PowerCircuitManager(pmr::memory_resource *resource)
+	: memoryresource(resource), circuits(resource), evaluationorder(resource), evaluationconverters(resource), statebuffers(resource)
 {
+	commandqueue = new PowerCommandQueue(resource);
+	eventqueue = new PowerEventQueue(resource);
+	registry = new PowerElementRegistry(resource);
+	buspool = new PowerElementPool<PowerBus>(resource);
+	sourcepool = new PowerElementPool<PowerSource>(resource);
+	consumerpool = new PowerElementPool<PowerConsumer>(resource);
+	chargablepool = new PowerElementPool<PowerSourceChargable>(resource);
+	converterpool = new PowerElementPool<PowerConverter>(resource);
 }
 
 
 PowerCircuitManager::~PowerCircuitManager()
 {
+	//the worker thread must be done with the elements before the pooled ones go.
+	delete topologybuilder;
+	delete buspool;
+	delete sourcepool;
+	delete consumerpool;
+	delete chargablepool;
+	delete converterpool;
+	//elements may well outlive their manager, they must not unregister from a deleted registry.
+	registry->detachAll();
+	delete registry;
+	delete commandqueue;
+	delete eventqueue;
+	delete eventstream;
+	for (auto i = statebuffers.begin(); i != statebuffers.end(); ++i)
+	{
+		delete (*i);
+	}
 }
 
 
@@ -25,7 +64,7 @@ PowerCircuit *PowerCircuitManager::CreateCircuit(PowerBus *initialbus)
 {
 	assert(initialbus->GetCircuit() == NULL && "New PowerCircuit can only be created with a bus that is not member of another circuit!");
 
-	PowerCircuit *newcircuit = new PowerCircuit(initialbus);
+	PowerCircuit *newcircuit = new (memoryresource) PowerCircuit(initialbus);
 	circuits.push_back(newcircuit);
 	return newcircuit;
 }
@@ -44,16 +83,12 @@ void PowerCircuitManager::MergeCircuits(PowerCircuit *circuit_a, PowerCircuit *c
 	assert(find(circuits.begin(), circuits.end(), circuit_a) != circuits.end() && "Attempting to merge circuit that is not managed by this PowerCIrcuitManager!");
 	assert(find(circuits.begin(), circuits.end(), circuit_b) != circuits.end() && "Attempting to merge circuit that is not managed by this PowerCIrcuitManager!");
 
-	vector<PowerSource*> sources;
-	circuit_b->GetPowerSources(sources);
-	for (auto source = sources.begin(); source != sources.end(); ++source)
+	for (auto source = circuit_b->powersources.begin(); source != circuit_b->powersources.end(); ++source)
 	{
 		circuit_a->AddPowerSource((*source));
 	}
 
-	vector<PowerBus*> buses;
-	circuit_b->GetPowerBuses(buses);
-	for (auto bus = buses.begin(); bus != buses.end(); ++bus)
+	for (auto bus = circuit_b->powerbuses.begin(); bus != circuit_b->powerbuses.end(); ++bus)
 	{
 		circuit_a->AddPowerBus((*bus));
 	}
@@ -65,33 +100,27 @@ void PowerCircuitManager::MergeCircuits(PowerCircuit *circuit_a, PowerCircuit *c
 void PowerCircuitManager::SplitCircuit(PowerCircuit *circuit, PowerBus *split_at, PowerParent *split_from)
 {
 	//set to store already processed parent to avoid endless recursion between buses.
-	set<PowerParent*> processed_parents;
-	processed_parents.insert(split_from);
+	pmr::set<PowerParent*> processed_parents(memoryresource);
 	processed_parents.insert(split_at);
 
 	//queue to walk through all descendants of split_at breadth first.
-	queue<PowerParent*> parents_to_process;
+	queue<PowerParent*, pmr::deque<PowerParent*>> parents_to_process{pmr::deque<PowerParent*>(memoryresource)};
 	parents_to_process.push(split_at);
-	PowerCircuit *newcircuit = NULL;
+	pmr::vector<PowerParent*> splitparents(memoryresource);
 
 	while (parents_to_process.size() > 0)
 	{
 		//take the next item from the queue
 		PowerParent *currentparent = parents_to_process.front();
 		parents_to_process.pop();
-
-		//remove the child from its old circuit and add it to the new one.
-		//create the circuit if it doesn't exist yet.
-		currentparent->GetCircuit()->RemovePowerParent(currentparent);
-		if (newcircuit == NULL)
+		if (currentparent == split_from)
 		{
-			//not as unsave as it looks. If the circuit does not yet exist, the current parent must necessarily be split_at.
-			newcircuit = CreateCircuit((PowerBus*)currentparent);
-		}
-		else
-		{
-			newcircuit->AddPowerParent(currentparent);
+			//split_at is still connected to split_from some other way, e.g. through a loop. Nothing to split,
+			//but the loop is gone.
+			circuit->RegisterStructureChange();
+			return;
 		}
+		splitparents.push_back(currentparent);
 
 		if (currentparent->GetParentType() == PPT_BUS)
 		{
@@ -100,7 +129,7 @@ void PowerCircuitManager::SplitCircuit(PowerCircuit *circuit, PowerBus *split_at
 			for (auto i = currentbus->parents.begin(); i != currentbus->parents.end(); ++i)
 			{
 				//check if the parent was already processed, if not, add it to the queue.
-				pair<set<PowerParent*>::iterator, bool> parent_was_processed = processed_parents.insert((*i));
+				pair<pmr::set<PowerParent*>::iterator, bool> parent_was_processed = processed_parents.insert((*i));
 				if (parent_was_processed.second)
 				{
 					parents_to_process.push((*i));
@@ -109,6 +138,22 @@ void PowerCircuitManager::SplitCircuit(PowerCircuit *circuit, PowerBus *split_at
 		}
 	}
 
+	//remove the parents from their old circuit and add them to the new one.
+	PowerCircuit *newcircuit = NULL;
+	for (auto i = splitparents.begin(); i != splitparents.end(); ++i)
+	{
+		(*i)->GetCircuit()->RemovePowerParent((*i));
+		if (newcircuit == NULL)
+		{
+			//not as unsave as it looks. The first parent is necessarily split_at.
+			newcircuit = CreateCircuit((PowerBus*)(*i));
+		}
+		else
+		{
+			newcircuit->AddPowerParent((*i));
+		}
+	}
+
 	if (circuit->powerbuses.size() == 0)
 	{
 		DeletePowerCircuit(circuit);
@@ -118,20 +163,69 @@ void PowerCircuitManager::SplitCircuit(PowerCircuit *circuit, PowerBus *split_at
 
 void PowerCircuitManager::Evaluate(double deltatime)
 {
+	if (topologybuilder != NULL)
+	{
+		//this is the frame boundary, the only safe point to swap in reachability tables that were built in the meantime.
+		applyFinishedTopologies();
+	}
+
+	if (eventstream != NULL)
+	{
+		eventstream->frame = evaluationcount + 1;
+	}
+	if (deferevents)
+	{
+		eventqueue->startRecording();
+	}
+
+	//changes posted from other threads are applied in one go. Elements only mark their circuit as changed,
+	//so the circuits evaluate once with all of them, no matter how many there were.
+	commandqueue->apply();
+
+	orderCircuitsByDemand();
 	reevaluate = true;
+	lastpasscount = 0;
 	while (reevaluate)
 	{
 		reevaluate = false;			//will be set to true again by circuit evaluation if the state changes after it's already been evaluated
-		for (auto circuit = circuits.begin(); circuit != circuits.end(); ++circuit)
+		evaluationpass++;
+		lastpasscount++;
+		for (auto circuit = evaluationorder.begin(); circuit != evaluationorder.end(); ++circuit)
 		{
 			(*circuit)->Evaluate(deltatime);
 		}
+		//supply limits flow the other way. If an input circuit couldn't meet the demand of a converter, or could now meet more of it,
+		//the output circuit has to be solved again with the new limit.
+		for (auto converter = evaluationconverters.begin(); converter != evaluationconverters.end(); ++converter)
+		{
+			if ((*converter)->UpdateInputLimit())
+			{
+				reevaluate = true;
+			}
+		}
+	}
+
+	evaluationcount++;
+	if (statebuffers.size() > 0)
+	{
+		publishState();
+	}
+
+	if (deferevents)
+	{
+		//the circuits are stable now, handlers can do what they want. Whatever they change will be evaluated next time.
+		eventqueue->dispatch();
 	}
 }
 
 void PowerCircuitManager::GetPowerCircuits(vector<PowerCircuit*> &OUT_circuits)
 {
-	OUT_circuits = circuits;
+	OUT_circuits.assign(circuits.begin(), circuits.end());
+}
+
+PowerSpan<PowerCircuit*> PowerCircuitManager::GetPowerCircuits()
+{
+	return PowerSpan<PowerCircuit*>(circuits.data(), circuits.size());
 }
 
 
@@ -143,4 +237,574 @@ unsigned int PowerCircuitManager::GetSize()
 void PowerCircuitManager::RegisterAlreadyEvaluatedCircuitChange()
 {
 	reevaluate = true;
+}
+
+
+unsigned int PowerCircuitManager::GetLastEvaluationPassCount()
+{
+	return lastpasscount;
+}
+
+
+void PowerCircuitManager::orderCircuitsByDemand()
+{
+	//every converter is an edge from the circuit it feeds to the circuit it draws from. Sorted topologically with Kahns algorithm,
+	//keeping the order of circuits that don't depend on each other.
+	pmr::unordered_map<PowerCircuit*, unsigned int> indices(memoryresource);
+	for (unsigned int i = 0; i < circuits.size(); ++i)
+	{
+		indices[circuits[i]] = i;
+	}
+	pmr::vector<unsigned int> feeding(circuits.size(), 0, memoryresource);	//number of circuits each circuit feeds that were not yet ordered.
+	pmr::vector<pair<unsigned int, unsigned int>> edges(memoryresource);		//(output circuit, input circuit)
+	evaluationconverters.clear();
+	for (unsigned int i = 0; i < circuits.size(); ++i)
+	{
+		PowerSpan<PowerSource*> sources = circuits[i]->GetPowerSources();
+		for (auto source = sources.begin(); source != sources.end(); ++source)
+		{
+			//converters present themselves as regular sources to their circuit.
+			PowerConverter *converter = dynamic_cast<PowerConverter*>((*source));
+			if (converter == NULL)
+			{
+				continue;
+			}
+			PowerCircuit *inputcircuit = converter->GetInputCircuit();
+			auto input = inputcircuit != NULL ? indices.find(inputcircuit) : indices.end();
+			if (input != indices.end() && input->second != i)
+			{
+				edges.push_back(make_pair(i, input->second));
+				evaluationconverters.push_back(converter);
+				feeding[input->second]++;
+			}
+		}
+	}
+
+	evaluationorder.clear();
+	if (edges.size() == 0)
+	{
+		evaluationorder.assign(circuits.begin(), circuits.end());
+		return;
+	}
+	sort(edges.begin(), edges.end());
+	pmr::vector<unsigned char> ordered(circuits.size(), 0, memoryresource);
+	for (unsigned int i = 0; i < circuits.size(); ++i)
+	{
+		if (feeding[i] == 0)
+		{
+			evaluationorder.push_back(circuits[i]);
+			ordered[i] = 1;
+		}
+	}
+	for (unsigned int next = 0; next < evaluationorder.size(); ++next)
+	{
+		unsigned int output = indices[evaluationorder[next]];
+		for (auto edge = lower_bound(edges.begin(), edges.end(), make_pair(output, 0u)); edge != edges.end() && edge->first == output; ++edge)
+		{
+			feeding[edge->second]--;
+			if (feeding[edge->second] == 0)
+			{
+				evaluationorder.push_back(circuits[edge->second]);
+				ordered[edge->second] = 1;
+			}
+		}
+	}
+	for (unsigned int i = 0; i < circuits.size(); ++i)
+	{
+		if (!ordered[i])
+		{
+			evaluationorder.push_back(circuits[i]);
+		}
+	}
+}
+
+
+void PowerCircuitManager::SetAsyncTopologyRebuild(bool enabled)
+{
+	if (enabled && topologybuilder == NULL)
+	{
+		topologybuilder = new PowerTopologyBuilder();
+	}
+	else if (!enabled && topologybuilder != NULL)
+	{
+		//don't leave any circuit without the reachability table it is waiting for.
+		FinishTopologyRebuilds();
+		delete topologybuilder;
+		topologybuilder = NULL;
+	}
+}
+
+
+bool PowerCircuitManager::IsAsyncTopologyRebuildEnabled()
+{
+	return topologybuilder != NULL;
+}
+
+
+void PowerCircuitManager::FinishTopologyRebuilds()
+{
+	if (topologybuilder != NULL)
+	{
+		topologybuilder->WaitUntilIdle();
+		applyFinishedTopologies();
+	}
+}
+
+
+PowerTopologyBuilder *PowerCircuitManager::GetTopologyBuilder()
+{
+	return topologybuilder;
+}
+
+
+void PowerCircuitManager::SetTopologyReduction(bool enabled)
+{
+	if (enabled == topologyreduction)
+	{
+		return;
+	}
+	topologyreduction = enabled;
+	for (auto i = circuits.begin(); i != circuits.end(); ++i)
+	{
+		(*i)->structurechanged = true;
+	}
+}
+
+
+bool PowerCircuitManager::IsTopologyReductionEnabled()
+{
+	return topologyreduction;
+}
+
+
+void PowerCircuitManager::SetNodalSolver(bool enabled)
+{
+	if (enabled == nodalsolver)
+	{
+		return;
+	}
+	nodalsolver = enabled;
+	for (auto i = circuits.begin(); i != circuits.end(); ++i)
+	{
+		(*i)->structurechanged = true;
+	}
+}
+
+
+bool PowerCircuitManager::IsNodalSolverEnabled()
+{
+	return nodalsolver;
+}
+
+
+void PowerCircuitManager::SetSolveMemoization(bool enabled)
+{
+	if (enabled == solvememoization)
+	{
+		return;
+	}
+	solvememoization = enabled;
+	//solves stored before memoization was disabled might be outdated once it is enabled again.
+	for (auto i = circuits.begin(); i != circuits.end(); ++i)
+	{
+		(*i)->GetSolveCache()->Clear();
+	}
+}
+
+
+bool PowerCircuitManager::IsSolveMemoizationEnabled()
+{
+	return solvememoization;
+}
+
+
+unsigned int PowerCircuitManager::createTopologyStamp()
+{
+	lasttopologystamp++;
+	return lasttopologystamp;
+}
+
+
+void PowerCircuitManager::applyFinishedTopologies()
+{
+	vector<TOPOLOGY_RESULT*> results;
+	topologybuilder->CollectResults(results);
+	for (auto i = results.begin(); i != results.end(); ++i)
+	{
+		TOPOLOGY_RESULT *result = (*i);
+		//the circuit might have been merged into another, or its structure might have changed again since the snapshot was taken.
+		//In both cases, the result is outdated and a newer one is either pending or will be requested during the next evaluation.
+		if (find(circuits.begin(), circuits.end(), result->circuit) != circuits.end() &&
+			result->circuit->topologystamp == result->topologystamp &&
+			!result->circuit->structurechanged)
+		{
+			result->circuit->applyTopology(result);
+		}
+		delete result;
+	}
+}
+
+
+PowerCommandQueue *PowerCircuitManager::GetCommandQueue()
+{
+	return commandqueue;
+}
+
+
+PowerEventQueue *PowerCircuitManager::GetEventQueue()
+{
+	return eventqueue;
+}
+
+
+void PowerCircuitManager::SetDeferredEvents(bool enabled)
+{
+	deferevents = enabled;
+}
+
+
+bool PowerCircuitManager::IsDeferringEvents()
+{
+	return deferevents;
+}
+
+
+PowerEventStream *PowerCircuitManager::EnableEventStream(unsigned int capacity)
+{
+	if (eventstream == NULL)
+	{
+		eventstream = new PowerEventStream(capacity, registry);
+		eventstream->frame = evaluationcount;
+		eventqueue->stream = eventstream;
+	}
+	return eventstream;
+}
+
+
+void PowerCircuitManager::DisableEventStream()
+{
+	eventqueue->stream = NULL;
+	delete eventstream;
+	eventstream = NULL;
+}
+
+
+PowerEventStream *PowerCircuitManager::GetEventStream()
+{
+	return eventstream;
+}
+
+
+PowerElementRegistry *PowerCircuitManager::GetRegistry()
+{
+	return registry;
+}
+
+
+pmr::memory_resource *PowerCircuitManager::GetMemoryResource()
+{
+	return memoryresource;
+}
+
+
+PowerBus *PowerCircuitManager::CreateBus(double voltage, double maxamps, unsigned int location_id)
+{
+	//buses register themselves with their manager.
+	return buspool->Create(voltage, maxamps, this, location_id);
+}
+
+
+PowerSource *PowerCircuitManager::CreateSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global)
+{
+	PowerSource *source = sourcepool->Create(minvoltage, maxvoltage, maxpower, internalresistance, location_id, global, memoryresource);
+	registry->registerElement(NULL, source);
+	return source;
+}
+
+
+PowerConsumer *PowerCircuitManager::CreateConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower, double minimumload, bool global)
+{
+	PowerConsumer *consumer = consumerpool->Create(minvoltage, maxvoltage, maxpower, location_id, standbypower, minimumload, global, memoryresource);
+	registry->registerElement(consumer, NULL);
+	return consumer;
+}
+
+
+PowerSourceChargable *PowerCircuitManager::CreateChargableSource(double minvoltage, double maxvoltage, double maxdischarge, double maxchargingpower, double charge,
+	double chargingefficiency, double internalresistance, unsigned int location_id, double minimumchargingload, bool global)
+{
+	PowerSourceChargable *source = chargablepool->Create(minvoltage, maxvoltage, maxdischarge, maxchargingpower, charge,
+		chargingefficiency, internalresistance, location_id, minimumchargingload, global, memoryresource);
+	registry->registerElement(source, source);
+	return source;
+}
+
+
+PowerConverter *PowerCircuitManager::CreateConverter(double minvoltage, double maxvoltage, double maxpower, double conversionefficiency, double internalresistance, unsigned int location_id, bool global)
+{
+	PowerConverter *converter = converterpool->Create(minvoltage, maxvoltage, maxpower, conversionefficiency, internalresistance, location_id, global, memoryresource);
+	registry->registerElement(converter, converter);
+	return converter;
+}
+
+
+void PowerCircuitManager::DeleteBus(PowerBus *bus)
+{
+	buspool->Destroy(bus);
+}
+
+
+void PowerCircuitManager::DeleteSource(PowerSource *source)
+{
+	sourcepool->Destroy(source);
+}
+
+
+void PowerCircuitManager::DeleteConsumer(PowerConsumer *consumer)
+{
+	consumerpool->Destroy(consumer);
+}
+
+
+void PowerCircuitManager::DeleteChargableSource(PowerSourceChargable *source)
+{
+	chargablepool->Destroy(source);
+}
+
+
+void PowerCircuitManager::DeleteConverter(PowerConverter *converter)
+{
+	converterpool->Destroy(converter);
+}
+
+
+unsigned int PowerCircuitManager::GetPooledElementCount()
+{
+	return buspool->GetSize() + sourcepool->GetSize() + consumerpool->GetSize() + chargablepool->GetSize() + converterpool->GetSize();
+}
+
+
+void PowerCircuitManager::QueryBusCurrents(const POWER_HANDLE *handles, unsigned int count, double *OUT_currents, double *OUT_maxcurrents)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		BUS_SOLVER_STATE *state = NULL;
+		if (slot != NULL && (slot->kinds & PEK_BUS) != 0)
+		{
+			state = ((PowerBus*)slot->parent)->busstate;
+		}
+		OUT_currents[i] = state != NULL ? state->current : 0;
+		if (OUT_maxcurrents != NULL) OUT_maxcurrents[i] = state != NULL ? state->maxcurrent : 0;
+	}
+}
+
+
+void PowerCircuitManager::QueryConsumerStates(const POWER_HANDLE *handles, unsigned int count, double *OUT_loads, double *OUT_inputcurrents, bool *OUT_running, bool *OUT_switchedin)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		CONSUMER_SOLVER_STATE *state = NULL;
+		if (slot != NULL && (slot->kinds & PEK_CONSUMER) != 0)
+		{
+			state = ((PowerConsumer*)slot->child)->consumerstate;
+		}
+		OUT_loads[i] = state != NULL ? state->load : 0;
+		if (OUT_inputcurrents != NULL) OUT_inputcurrents[i] = state != NULL ? state->current : 0;
+		if (OUT_running != NULL) OUT_running[i] = state != NULL && state->running;
+		if (OUT_switchedin != NULL) OUT_switchedin[i] = state != NULL && state->child.switchedin;
+	}
+}
+
+
+void PowerCircuitManager::QuerySourceStates(const POWER_HANDLE *handles, unsigned int count, double *OUT_outputcurrents, bool *OUT_switchedin)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		SOURCE_SOLVER_STATE *state = NULL;
+		if (slot != NULL && (slot->kinds & PEK_SOURCE) != 0)
+		{
+			state = ((PowerSource*)slot->parent)->sourcestate;
+		}
+		OUT_outputcurrents[i] = state != NULL ? state->outputcurrent : 0;
+		if (OUT_switchedin != NULL) OUT_switchedin[i] = state != NULL && state->parent.switchedin;
+	}
+}
+
+
+void PowerCircuitManager::QueryCharges(const POWER_HANDLE *handles, unsigned int count, double *OUT_charges, double *OUT_maxcharges)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		CHARGABLE_SOLVER_STATE *state = NULL;
+		if (slot != NULL && (slot->kinds & PEK_CHARGABLE) != 0)
+		{
+			state = ((PowerSourceChargable*)(PowerSource*)slot->parent)->chargablestate;
+		}
+		OUT_charges[i] = state != NULL ? state->charge : 0;
+		if (OUT_maxcharges != NULL) OUT_maxcharges[i] = state != NULL ? state->maxcharge : 0;
+	}
+}
+
+
+unsigned int PowerCircuitManager::SetConsumerLoads(PowerSpan<POWER_HANDLE> handles, PowerSpan<double> loads)
+{
+	assert(handles.size() == loads.size() && "Number of loads doesn't match the number of consumers!");
+	unsigned int rejected = 0;
+	pmr::vector<PowerParent*> changedparents(memoryresource);
+	for (unsigned int i = 0; i < handles.size(); ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		if (slot == NULL || (slot->kinds & PEK_CONSUMER) == 0)
+		{
+			continue;
+		}
+		PowerConsumer *consumer = (PowerConsumer*)slot->child;
+		assert(loads[i] >= 0 && loads[i] <= 1 && "Somebody's trying to set an invalid load!");
+		double oldload = consumer->consumerstate->load;
+		if (loads[i] != oldload)
+		{
+			if (!consumer->applyConsumerLoad(loads[i]))
+			{
+				rejected++;
+			}
+			changedparents.insert(changedparents.end(), consumer->parents.begin(), consumer->parents.end());
+			consumer->raiseConsumerLoadEvent(oldload);
+		}
+	}
+	registerChildStateChanges(changedparents);
+	return rejected;
+}
+
+
+void PowerCircuitManager::SetChildrenSwitchedIn(PowerSpan<POWER_HANDLE> handles, PowerSpan<bool> switchedin)
+{
+	assert(handles.size() == switchedin.size() && "Number of switch states doesn't match the number of children!");
+	pmr::vector<PowerParent*> changedparents(memoryresource);
+	for (unsigned int i = 0; i < handles.size(); ++i)
+	{
+		REGISTRY_SLOT *slot = registry->getSlot(handles[i]);
+		if (slot == NULL || slot->child == NULL)
+		{
+			continue;
+		}
+		PowerChild *child = slot->child;
+		bool wasswitchedin = child->childstate->switchedin;
+		if (child->childcanswitch && switchedin[i] != wasswitchedin)
+		{
+			child->childstate->switchedin = switchedin[i];
+			changedparents.insert(changedparents.end(), child->parents.begin(), child->parents.end());
+			child->raiseChildSwitchEvent(wasswitchedin);
+		}
+	}
+	registerChildStateChanges(changedparents);
+}
+
+
+void PowerCircuitManager::registerChildStateChanges(pmr::vector<PowerParent*> &parents)
+{
+	sort(parents.begin(), parents.end());
+	auto last = unique(parents.begin(), parents.end());
+	for (auto i = parents.begin(); i != last; ++i)
+	{
+		(*i)->RegisterChildStateChange();
+	}
+}
+
+
+PowerStateBuffer *PowerCircuitManager::CreateStateBuffer()
+{
+	PowerStateBuffer *buffer = new PowerStateBuffer();
+	statebuffers.push_back(buffer);
+	return buffer;
+}
+
+
+void PowerCircuitManager::DeleteStateBuffer(PowerStateBuffer *buffer)
+{
+	auto i = find(statebuffers.begin(), statebuffers.end(), buffer);
+	assert(i != statebuffers.end() && "Cannot delete PowerStateBuffer that was not created by this PowerCircuitManager!");
+
+	statebuffers.erase(i);
+	delete buffer;
+}
+
+
+void PowerCircuitManager::publishState()
+{
+	//the state is gathered once into the first buffer, the others get a copy.
+	//Frames are reused, so after the first few evaluations this doesn't allocate anymore unless the structure grows.
+	POWER_STATE_FRAME *state = statebuffers[0]->getWriteFrame();
+	state->frame = evaluationcount;
+	state->buses.clear();
+	state->sources.clear();
+	state->consumers.clear();
+	state->chargables.clear();
+
+	for (auto circuit = circuits.begin(); circuit != circuits.end(); ++circuit)
+	{
+		for (auto i = (*circuit)->powerbuses.begin(); i != (*circuit)->powerbuses.end(); ++i)
+		{
+			PowerBus *bus = (*i);
+			state->buses.push_back(BUS_STATE());
+			BUS_STATE &busstate = state->buses.back();
+			busstate.bus = bus;
+			busstate.handle = registry->GetHandle((PowerChild*)bus);
+			busstate.current = bus->GetCurrent();
+			busstate.maxcurrent = bus->GetMaxCurrent();
+
+			for (auto child = bus->children.begin(); child != bus->children.end(); ++child)
+			{
+				if ((*child)->GetChildType() == PCT_CONSUMER)
+				{
+					PowerConsumer *consumer = (PowerConsumer*)(*child);
+					state->consumers.push_back(CONSUMER_STATE());
+					CONSUMER_STATE &consumerstate = state->consumers.back();
+					consumerstate.consumer = consumer;
+					consumerstate.handle = registry->GetHandle(consumer);
+					consumerstate.inputcurrent = consumer->GetInputCurrent();
+					consumerstate.load = consumer->GetConsumerLoad();
+					consumerstate.powerconsumption = consumer->GetCurrentPowerConsumption();
+					consumerstate.running = consumer->IsRunning();
+					consumerstate.switchedin = consumer->IsChildSwitchedIn();
+				}
+			}
+		}
+
+		for (auto i = (*circuit)->powersources.begin(); i != (*circuit)->powersources.end(); ++i)
+		{
+			PowerSource *source = (*i);
+			state->sources.push_back(SOURCE_STATE());
+			SOURCE_STATE &sourcestate = state->sources.back();
+			sourcestate.source = source;
+			sourcestate.handle = registry->GetHandle(source);
+			sourcestate.outputcurrent = source->GetOutputCurrent();
+			sourcestate.poweroutput = source->GetCurrentPowerOutput();
+			sourcestate.maxpoweroutput = source->GetMaxPowerOutput();
+			sourcestate.switchedin = source->IsParentSwitchedIn();
+
+			PowerSourceChargable *chargable = dynamic_cast<PowerSourceChargable*>(source);
+			if (chargable != NULL)
+			{
+				state->chargables.push_back(CHARGABLE_STATE());
+				CHARGABLE_STATE &chargablestate = state->chargables.back();
+				chargablestate.chargable = chargable;
+				chargablestate.handle = sourcestate.handle;
+				chargablestate.charge = chargable->GetCharge();
+				chargablestate.maxcharge = chargable->GetMaxCharge();
+			}
+		}
+	}
+
+	for (unsigned int i = 1; i < statebuffers.size(); ++i)
+	{
+		*(statebuffers[i]->getWriteFrame()) = *state;
+	}
+	for (auto i = statebuffers.begin(); i != statebuffers.end(); ++i)
+	{
+		(*i)->publish();
+	}
 }
\ No newline at end of file
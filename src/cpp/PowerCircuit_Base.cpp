@@ -7,12 +7,38 @@
 #include "PowerCircuit_Base.h"
 
 
-PowerCircuit_Base::PowerCircuit_Base(double voltage)
-	:voltage(voltage)
+PowerCircuit_Base::PowerCircuit_Base(double voltage, pmr::memory_resource *resource)
+	:powersources(resource), powerbuses(resource), voltage(voltage)
 {
 }
 
 
+void *PowerCircuit_Base::operator new(size_t size, pmr::memory_resource *resource)
+{
+	size += sizeof(ALLOCATION_HEADER);
+	ALLOCATION_HEADER *header = (ALLOCATION_HEADER*)resource->allocate(size, alignof(ALLOCATION_HEADER));
+	header->resource = resource;
+	header->size = size;
+	return header + 1;
+}
+
+
+void PowerCircuit_Base::operator delete(void *circuit, pmr::memory_resource *resource)
+{
+	operator delete(circuit);
+}
+
+
+void PowerCircuit_Base::operator delete(void *circuit)
+{
+	if (circuit != NULL)
+	{
+		ALLOCATION_HEADER *header = (ALLOCATION_HEADER*)circuit - 1;
+		header->resource->deallocate(header, header->size, alignof(ALLOCATION_HEADER));
+	}
+}
+
+
 PowerCircuit_Base::~PowerCircuit_Base()
 {
 }
@@ -73,12 +99,22 @@ void PowerCircuit_Base::RemovePowerBus(PowerBus *bus)
 
 void PowerCircuit_Base::GetPowerSources(vector<PowerSource*> &OUT_sources)
 {
-	OUT_sources = powersources;
+	OUT_sources.assign(powersources.begin(), powersources.end());
+}
+
+PowerSpan<PowerSource*> PowerCircuit_Base::GetPowerSources()
+{
+	return PowerSpan<PowerSource*>(powersources.data(), powersources.size());
 }
 
 void PowerCircuit_Base::GetPowerBuses(vector<PowerBus*> &OUT_buses)
 {
-	OUT_buses = powerbuses;
+	OUT_buses.assign(powerbuses.begin(), powerbuses.end());
+}
+
+PowerSpan<PowerBus*> PowerCircuit_Base::GetPowerBuses()
+{
+	return PowerSpan<PowerBus*>(powerbuses.data(), powerbuses.size());
 }
 
 void PowerCircuit_Base::RegisterStateChange()
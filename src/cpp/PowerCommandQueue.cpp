@@ -0,0 +1,237 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerConsumer.h"
+#include "PowerSource.h"
+#include "PowerSourceChargable.h"
+#include "PowerBus.h"
+#include "PowerCommandQueue.h"
+#include <set>
+
+
+PowerCommandQueue::PowerCommandQueue(pmr::memory_resource *resource)
+	: head(&stub), tail(&stub), pending(resource)
+{
+}
+
+
+PowerCommandQueue::~PowerCommandQueue()
+{
+	//delete whatever was posted but never applied.
+	POWER_COMMAND *command = tail;
+	while (command != NULL)
+	{
+		POWER_COMMAND *next = command->next.load(memory_order_acquire);
+		if (command != &stub)
+		{
+			delete command;
+		}
+		command = next;
+	}
+}
+
+
+void PowerCommandQueue::PostConsumerLoad(PowerConsumer *consumer, double load)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_CONSUMER_LOAD;
+	command->target = consumer;
+	command->value = load;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostConsumerRunning(PowerConsumer *consumer, bool running)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_CONSUMER_RUNNING;
+	command->target = consumer;
+	command->flag = running;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostMaxPowerConsumption(PowerConsumer *consumer, double watts)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_MAX_POWER_CONSUMPTION;
+	command->target = consumer;
+	command->value = watts;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostChildSwitchedIn(PowerChild *child, bool switchedin)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_CHILD_SWITCHED_IN;
+	command->target = child;
+	command->flag = switchedin;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostParentSwitchedIn(PowerParent *parent, bool switchedin)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_PARENT_SWITCHED_IN;
+	command->target = parent;
+	command->flag = switchedin;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostAutoswitchEnabled(PowerParent *parent, bool enabled)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_AUTOSWITCH;
+	command->target = parent;
+	command->flag = enabled;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostChargingMode(PowerSourceChargable *chargable, bool charging)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_CHARGING_MODE;
+	command->target = chargable;
+	command->flag = charging;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostMaxPowerOutput(PowerSource *source, double watts)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_MAX_POWER_OUTPUT;
+	command->target = source;
+	command->value = watts;
+	post(command);
+}
+
+
+void PowerCommandQueue::PostBusMaxCurrent(PowerBus *bus, double amps)
+{
+	POWER_COMMAND *command = new POWER_COMMAND;
+	command->type = PCMD_BUS_MAX_CURRENT;
+	command->target = bus;
+	command->value = amps;
+	post(command);
+}
+
+
+void PowerCommandQueue::post(POWER_COMMAND *command)
+{
+	command->next.store(NULL, memory_order_relaxed);
+	//claim the head position first, then link the previous head to us.
+	//Between the two, the queue is briefly cut at the previous head, and apply() will just stop there.
+	POWER_COMMAND *previous = head.exchange(command, memory_order_acq_rel);
+	previous->next.store(command, memory_order_release);
+}
+
+
+void PowerCommandQueue::apply()
+{
+	pending.clear();
+	while (true)
+	{
+		POWER_COMMAND *next = tail->next.load(memory_order_acquire);
+		if (tail == &stub)
+		{
+			if (next == NULL)
+			{
+				break;
+			}
+			//skip over the stub, it doesn't carry a command.
+			tail = next;
+			next = next->next.load(memory_order_acquire);
+		}
+
+		if (next != NULL)
+		{
+			pending.push_back(tail);
+			tail = next;
+			continue;
+		}
+
+		//tail is the last linked command. It can only be taken if no producer is about to link to it,
+		//so we put the stub behind it to have something to leave in the queue.
+		if (tail != head.load(memory_order_acquire))
+		{
+			//a producer is in the middle of posting. Leave the rest for the next evaluation.
+			break;
+		}
+		post(&stub);
+		next = tail->next.load(memory_order_acquire);
+		if (next == NULL)
+		{
+			//another producer got in between. Same as above.
+			break;
+		}
+		pending.push_back(tail);
+		tail = next;
+	}
+
+	if (pending.size() == 0)
+	{
+		return;
+	}
+
+	//only the last command of a type to an element matters, the ones before it would be overwritten anyways.
+	//walk backwards, so the first one we see of every kind is the one to apply.
+	pmr::set<pair<void*, POWER_COMMAND_TYPE>> applied(pending.get_allocator().resource());
+	pmr::vector<bool> skip(pending.size(), false, pending.get_allocator().resource());
+	for (unsigned int i = pending.size(); i > 0; --i)
+	{
+		skip[i - 1] = !applied.insert(make_pair(pending[i - 1]->target, pending[i - 1]->type)).second;
+	}
+
+	//apply in the order they were posted, so commands of different types still take effect in the expected order.
+	for (unsigned int i = 0; i < pending.size(); ++i)
+	{
+		POWER_COMMAND *command = pending[i];
+		if (!skip[i])
+		{
+			switch (command->type)
+			{
+			case PCMD_CONSUMER_LOAD:
+				((PowerConsumer*)command->target)->SetConsumerLoad(command->value);
+				break;
+			case PCMD_CONSUMER_RUNNING:
+				((PowerConsumer*)command->target)->SetRunning(command->flag);
+				break;
+			case PCMD_MAX_POWER_CONSUMPTION:
+				((PowerConsumer*)command->target)->SetMaxPowerConsumption(command->value);
+				break;
+			case PCMD_CHILD_SWITCHED_IN:
+				((PowerChild*)command->target)->SetChildSwitchedIn(command->flag);
+				break;
+			case PCMD_PARENT_SWITCHED_IN:
+				((PowerParent*)command->target)->SetParentSwitchedIn(command->flag);
+				break;
+			case PCMD_AUTOSWITCH:
+				((PowerParent*)command->target)->SetAutoswitchEnabled(command->flag);
+				break;
+			case PCMD_CHARGING_MODE:
+				if (command->flag)
+				{
+					((PowerSourceChargable*)command->target)->SetToCharging();
+				}
+				else
+				{
+					((PowerSourceChargable*)command->target)->SetToProviding();
+				}
+				break;
+			case PCMD_MAX_POWER_OUTPUT:
+				((PowerSource*)command->target)->SetMaxPowerOutput(command->value);
+				break;
+			case PCMD_BUS_MAX_CURRENT:
+				((PowerBus*)command->target)->SetMaxCurrent(command->value);
+				break;
+			}
+		}
+		delete command;
+	}
+}
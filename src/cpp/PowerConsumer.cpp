@@ -3,18 +3,25 @@
 #include "PowerChild.h"
 #include "PowerConsumer.h"
 #include "PowerParent.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
 
 
-PowerConsumer::PowerConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower, double minimumload, bool global)
-	: PowerChild(PCT_CONSUMER, minvoltage, maxvoltage), maxpowerconsumption(maxpower), locationid(location_id), minimumload(minimumload), global(global)
+PowerConsumer::PowerConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower, double minimumload, bool global, pmr::memory_resource *resource)
+	: PowerChild(PCT_CONSUMER, minvoltage, maxvoltage, true, resource), locationid(location_id), global(global)
 {
+	consumerstate = PowerStateTable<CONSUMER_SOLVER_STATE>::Get().Allocate();
+	childstate = &consumerstate->child;
+	consumerstate->maxpower = maxpower;
+	consumerstate->minimumload = minimumload;
 	if (standbypower == -1)
 	{
-		this->standbypower = maxpower * 0.001;
+		consumerstate->standbypower = maxpower * 0.001;
 	}
 	else
 	{
-		this->standbypower = standbypower;
+		consumerstate->standbypower = standbypower;
 	}
 //	SetConsumerLoad(0);
 }
@@ -22,26 +29,26 @@ PowerConsumer::PowerConsumer(double minvoltage, double maxvoltage, double maxpow
 
 PowerConsumer::~PowerConsumer()
 {
-
+	PowerStateTable<CONSUMER_SOLVER_STATE>::Get().Free(consumerstate);
 }
 
 
 double PowerConsumer::GetMaxPowerConsumption()
 {
-	return maxpowerconsumption;
+	return consumerstate->maxpower;
 }
 
 double PowerConsumer::GetCurrentPowerConsumption()
 {
-	if (running)
+	if (consumerstate->running)
 	{
-		if (consumerload > 0)
+		if (consumerstate->load > 0)
 		{
-			return consumerload * maxpowerconsumption;
+			return consumerstate->load * consumerstate->maxpower;
 		}
 		else
 		{
-			return standbypower;
+			return consumerstate->standbypower;
 		}
 	}
 	else
@@ -52,36 +59,44 @@ double PowerConsumer::GetCurrentPowerConsumption()
 
 bool PowerConsumer::IsRunning()
 {
-	return running;
+	return consumerstate->running;
 }
 
 
 void PowerConsumer::SetRunning(bool running)
 {
-	if (running != this->running)
+	if (running != consumerstate->running)
 	{
-		this->running = running;
+		consumerstate->running = running;
 		calculateNewProperties();
-		if (runningChanged) runningChanged(this);
+		PowerEventQueue *eventqueue = getEventQueue();
+		if (eventqueue != NULL)
+		{
+			eventqueue->Raise(PEVT_CONSUMER_RUNNING, this, !running);
+		}
+		else
+		{
+			fireRunningEvent(!running);
+		}
 	}
 }
 
 
 double PowerConsumer::GetInputCurrent()
 {
-	return consumercurrent;
+	return consumerstate->current;
 }
 
 
 double PowerConsumer::GetConsumerLoad()
 {
-	return consumerload;
+	return consumerstate->load;
 }
 
 
 double PowerConsumer::GetConsumerMinimumLoad()
 {
-	return minimumload;
+	return consumerstate->minimumload;
 }
 
 
@@ -90,27 +105,51 @@ bool PowerConsumer::SetConsumerLoad(double load)
 	assert(load >= 0 && load <= 1 && "Somebody's trying to set an invalid load!");
 
 	bool result = true;
-	if (load != consumerload)
+	if (load != consumerstate->load)
 	{
-		if (load >= minimumload)
-		{
-			consumerload = load;
-		}
-		else 
-		{
-			consumerload = 0;
-			result = false;
-		}
-		calculateNewProperties();
-		if (consumerLoadChanged) consumerLoadChanged(this);
+		double oldload = consumerstate->load;
+		result = applyConsumerLoad(load);
+		registerStateChangeWithParents();
+		raiseConsumerLoadEvent(oldload);
+	}
+	return result;
+}
+
+
+bool PowerConsumer::applyConsumerLoad(double load)
+{
+	bool result = true;
+	if (load >= consumerstate->minimumload)
+	{
+		consumerstate->load = load;
 	}
+	else 
+	{
+		consumerstate->load = 0;
+		result = false;
+	}
+	updateProperties();
 	return result;
 }
 
 
+void PowerConsumer::raiseConsumerLoadEvent(double oldload)
+{
+	PowerEventQueue *eventqueue = getEventQueue();
+	if (eventqueue != NULL)
+	{
+		eventqueue->Raise(PEVT_CONSUMER_LOAD, this, oldload);
+	}
+	else
+	{
+		fireConsumerLoadEvent(oldload);
+	}
+}
+
+
 bool PowerConsumer::SetConsumerLoadForCurrent(double current)
 {
-	double loadatcurrent = current / (maxpowerconsumption / inputvoltage.current);
+	double loadatcurrent = current / (consumerstate->maxpower / childstate->voltage);
 	if (loadatcurrent > 1)
 	{
 		//the consumer can't consume this much current!
@@ -124,10 +163,10 @@ bool PowerConsumer::SetConsumerLoadForCurrent(double current)
 
 void PowerConsumer::SetMaxPowerConsumption(double newconsumption)
 {
-	if (newconsumption != maxpowerconsumption)
+	if (newconsumption != consumerstate->maxpower)
 	{
-		maxpowerconsumption = newconsumption;
-		maxconsumercurrent = maxpowerconsumption / inputvoltage.current;
+		consumerstate->maxpower = newconsumption;
+		consumerstate->maxcurrent = consumerstate->maxpower / childstate->voltage;
 		calculateNewProperties();
 	}
 }
@@ -135,36 +174,42 @@ void PowerConsumer::SetMaxPowerConsumption(double newconsumption)
 
 void PowerConsumer::calculateNewProperties()
 {
-	consumercurrent = GetCurrentPowerConsumption() / inputvoltage.current;
+	updateProperties();
+	registerStateChangeWithParents();
+}
+
+
+void PowerConsumer::updateProperties()
+{
+	consumerstate->current = GetCurrentPowerConsumption() / childstate->voltage;
 	double current = 0;
-	if (consumerload < minimumload)
+	if (consumerstate->load < consumerstate->minimumload)
 	{
 		//the consumer is on standby
-		current = standbypower / inputvoltage.current;
+		current = consumerstate->standbypower / childstate->voltage;
 	}
 	else
 	{
-		current = maxconsumercurrent * consumerload;
+		current = consumerstate->maxcurrent * consumerstate->load;
 	}
-	consumerresistance = inputvoltage.current / current;   //a note to the confused, which will probably be future me: inputvoltage.current is current input voltage, nothig to do with... well... current.
-	registerStateChangeWithParents();
+	consumerstate->resistance = childstate->voltage / current;   //a note to the confused, which will probably be future me: childstate->voltage is current input voltage, nothig to do with... well... current.
 }
 
 
 void PowerConsumer::ConnectChildToParent(PowerParent *parent, bool bidirectional)
 {
 	PowerChild::ConnectChildToParent(parent, bidirectional);
-	inputvoltage.current = parent->GetOutputVoltageInfo().current;
-	maxconsumercurrent = maxpowerconsumption / inputvoltage.current;
+	childstate->voltage = parent->GetOutputVoltageInfo().current;
+	consumerstate->maxcurrent = consumerstate->maxpower / childstate->voltage;
 	calculateNewProperties();
 }
 
 void PowerConsumer::DisconnectChildFromParent(PowerParent *parent, bool bidirectional)
 {
 	PowerChild::DisconnectChildFromParent(parent, bidirectional);
-	running = false;
-	consumerload = 0;
-	maxconsumercurrent = -1;
+	consumerstate->running = false;
+	consumerstate->load = 0;
+	consumerstate->maxcurrent = -1;
 }
 
 /*
@@ -193,7 +238,7 @@ bool PowerConsumer::CanConnectToParent(PowerParent *parent, bool bidirectional)
 
 double PowerConsumer::GetChildResistance()
 {
-	return consumerresistance;
+	return consumerstate->resistance;
 }
 
 unsigned int PowerConsumer::GetLocationId()
@@ -206,3 +251,28 @@ bool PowerConsumer::IsGlobal()
 	return global;
 }
 
+
+void PowerConsumer::fireRunningEvent(bool wasrunning)
+{
+	if (consumerstate->running != wasrunning && childsubscriptions != NULL) childsubscriptions->runningchanged.Invoke(this);
+}
+
+
+void PowerConsumer::fireConsumerLoadEvent(double oldload)
+{
+	if (consumerstate->load != oldload && childsubscriptions != NULL) childsubscriptions->loadchanged.Invoke(this);
+}
+
+
+unsigned int PowerConsumer::OnRunningChange(function<void(PowerConsumer*)> lambda)
+{
+	CHILD_SUBSCRIPTIONS *subscriptions = getChildSubscriptions();
+	return subscriptions->Add(subscriptions->runningchanged, lambda);
+}
+
+
+unsigned int PowerConsumer::OnConsumerLoadChange(function<void(PowerConsumer*)> lambda)
+{
+	CHILD_SUBSCRIPTIONS *subscriptions = getChildSubscriptions();
+	return subscriptions->Add(subscriptions->loadchanged, lambda);
+}
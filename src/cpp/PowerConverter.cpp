@@ -9,6 +9,7 @@
 #include "PowerCircuit.h"
 #include "PowerCircuitManager.h"
 #include "PowerConverter.h"
+#include "PowerSolverState.h"
 
 
 PowerConverter::PowerConverter(double minvoltage,
@@ -17,9 +18,10 @@ PowerConverter::PowerConverter(double minvoltage,
 							   double conversionefficiency,
 							   double internalresistance,
 							   unsigned int location_id,
-							   bool global)
-	: PowerSource(minvoltage, maxvoltage, maxpower, internalresistance, location_id, global),
-	  PowerConsumer(minvoltage, maxvoltage, maxpower, location_id, -1, 0, global),
+							   bool global,
+							   pmr::memory_resource *resource)
+	: PowerSource(minvoltage, maxvoltage, maxpower, internalresistance, location_id, global, resource),
+	  PowerConsumer(minvoltage, maxvoltage, maxpower, location_id, -1, 0, global, resource),
 	  conversionefficiency(conversionefficiency)
 {
 
@@ -44,6 +46,30 @@ void PowerConverter::SetConversionEfficiency(double efficiency)
 
 
 
+double PowerConverter::GetInputCurrentForOutput(double amps)
+{
+	return convertOutputCurrentToInputCurrent(amps);
+}
+
+
+PowerCircuit *PowerConverter::GetInputCircuit()
+{
+	//looked up every time, the circuit of the parent changes when circuits are merged or split.
+	return parents.size() > 0 ? parents[0]->GetCircuit() : NULL;
+}
+
+
+bool PowerConverter::UpdateInputLimit()
+{
+	const double tolerance = 1e-9;
+	double prevmaxcurrent = sourcestate->maxoutputcurrent;
+	bool waslimited = sourcestate->outputcurrent >= prevmaxcurrent * (1 - tolerance);
+	double maxcurrent = GetMaxOutputCurrent();
+	return sourcestate->outputcurrent > maxcurrent * (1 + tolerance) + tolerance ||
+		(waslimited && maxcurrent > prevmaxcurrent * (1 + tolerance) + tolerance);
+}
+
+
 bool PowerConverter::CanConnectToChild(PowerChild *child, bool bidirectional)
 {
 	//first check if this could even connect to the child as a normal power source.
@@ -76,14 +102,6 @@ bool PowerConverter::CanConnectToParent(PowerParent *parent, bool bidirectional)
 }
 
 
-void PowerConverter::ConnectChildToParent(PowerParent *parent, bool bidirectional)
-{
-	//connect like a normal consumer, but note the parents circuit
-	PowerConsumer::ConnectChildToParent(parent, bidirectional);
-	childcircuit = parent->GetCircuit();
-}
-
-
 void PowerConverter::Evaluate(double deltatime)
 {
 	//TODO?	
@@ -100,35 +118,41 @@ bool PowerConverter::SetConsumerLoad(double load)
 
 void PowerConverter::SetRequestedCurrent(double amps)
 {
-	if (amps != curroutputcurrent)
+	if (amps != sourcestate->outputcurrent)
 	{
-		double prevconsumercurrent = consumercurrent;
+		double prevconsumercurrent = consumerstate->current;
 		//let the power source do its thing
 		PowerSource::SetRequestedCurrent(amps);
 		//The power consumer must of course draw an equivalent amount of power from the providing circuit.
-		PowerConsumer::SetConsumerLoadForCurrent(convertOutputCurrentToInputCurrent(amps));
+		PowerConsumer::SetConsumerLoadForCurrent(GetInputCurrentForOutput(amps));
 		//finally, the circuit providing the power will have to know how much unexpected power it has left to give away during this evaluation.
-		childcircuit->RegisterCrossCircuitCurrentDemandChange(consumercurrent - prevconsumercurrent);
+		PowerCircuit *inputcircuit = GetInputCircuit();
+		if (inputcircuit != NULL)
+		{
+			inputcircuit->RegisterCrossCircuitCurrentDemandChange(consumerstate->current - prevconsumercurrent);
+		}
 	}
 }
 
 
 double PowerConverter::GetMaxOutputCurrent(bool force)
 {
-	//TODO: Produces incremental error. Must find way to calculate absolute, but still cheap.
-	if (IsParentSwitchedIn() || (IsAutoswitchEnabled() && force))
+	PowerCircuit *inputcircuit = GetInputCircuit();
+	if (inputcircuit != NULL && (IsParentSwitchedIn() || (IsAutoswitchEnabled() && force)))
 	{
 		//if we're operable, return whatever the circuit the consumer side is switched into has left over, converted into the voltage of the source side.
 		//there is one problem, though. The power the converter is already drawing is, as far as the circuit is concerned, not surplus. It's being eaten by one of its consumers, after all.
 		//So the power the converter is currently getting is available in addition to anything the circuit might still have left over.
 		double mycurrent = max(0.0, PowerConsumer::GetInputCurrent());
-		double surpluscurrent = childcircuit->GetMaximumSurplusCurrent() + mycurrent;
+		//The surplus only contains demand changes registered since the input circuit was last solved. The manager solves output circuits before
+		//their input circuits, so those changes are cleared once per frame at the latest and can't build up an error over time.
+		double surpluscurrent = inputcircuit->GetMaximumSurplusCurrent() + mycurrent;
 		double outputcurrent = convertInputCurrentToOutputCurrent(surpluscurrent);
 		
-		if (outputcurrent != maxoutcurrent)
+		if (outputcurrent != sourcestate->maxoutputcurrent)
 		{
 			//apparently, the state in the consumer circuit has changed.
-			maxoutcurrent = outputcurrent;
+			sourcestate->maxoutputcurrent = outputcurrent;
 			RegisterChildStateChange();
 		}
 
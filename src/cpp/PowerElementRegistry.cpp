@@ -0,0 +1,231 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerConsumer.h"
+#include "PowerSource.h"
+#include "PowerSourceChargable.h"
+#include "PowerBus.h"
+#include "PowerElementRegistry.h"
+
+
+PowerElementRegistry::PowerElementRegistry(pmr::memory_resource *resource)
+	: slots(resource), freeslots(resource)
+{
+}
+
+
+PowerElementRegistry::~PowerElementRegistry()
+{
+}
+
+
+POWER_HANDLE PowerElementRegistry::GetHandle(PowerChild *element)
+{
+	if (element == NULL || element->registry != this)
+	{
+		return 0;
+	}
+	return element->handle;
+}
+
+
+POWER_HANDLE PowerElementRegistry::GetHandle(PowerParent *element)
+{
+	if (element == NULL || element->registry != this)
+	{
+		return 0;
+	}
+	return element->handle;
+}
+
+
+bool PowerElementRegistry::IsValid(POWER_HANDLE handle)
+{
+	return getSlot(handle) != NULL;
+}
+
+
+PowerChild *PowerElementRegistry::ResolveChild(POWER_HANDLE handle)
+{
+	REGISTRY_SLOT *slot = getSlot(handle);
+	return slot != NULL ? slot->child : NULL;
+}
+
+
+PowerParent *PowerElementRegistry::ResolveParent(POWER_HANDLE handle)
+{
+	REGISTRY_SLOT *slot = getSlot(handle);
+	return slot != NULL ? slot->parent : NULL;
+}
+
+
+PowerBus *PowerElementRegistry::ResolveBus(POWER_HANDLE handle)
+{
+	PowerParent *parent = ResolveParent(handle);
+	if (parent != NULL && parent->GetParentType() == PPT_BUS)
+	{
+		return (PowerBus*)parent;
+	}
+	return NULL;
+}
+
+
+PowerSource *PowerElementRegistry::ResolveSource(POWER_HANDLE handle)
+{
+	PowerParent *parent = ResolveParent(handle);
+	if (parent != NULL && parent->GetParentType() == PPT_SOURCE)
+	{
+		return (PowerSource*)parent;
+	}
+	return NULL;
+}
+
+
+PowerConsumer *PowerElementRegistry::ResolveConsumer(POWER_HANDLE handle)
+{
+	PowerChild *child = ResolveChild(handle);
+	if (child != NULL && child->GetChildType() == PCT_CONSUMER)
+	{
+		return (PowerConsumer*)child;
+	}
+	return NULL;
+}
+
+
+unsigned int PowerElementRegistry::GetSize()
+{
+	return slots.size() - freeslots.size();
+}
+
+
+unsigned int PowerElementRegistry::GetHandles(unsigned int kinds, POWER_HANDLE *OUT_handles, unsigned int maxcount)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < slots.size(); ++i)
+	{
+		if ((slots[i].kinds & kinds) != 0)
+		{
+			if (count < maxcount)
+			{
+				OUT_handles[count] = (slots[i].generation << INDEX_BITS) | i;
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+
+unsigned int PowerElementRegistry::GetHandleIndex(POWER_HANDLE handle)
+{
+	return handle & INDEX_MASK;
+}
+
+
+POWER_HANDLE PowerElementRegistry::registerElement(PowerChild *child, PowerParent *parent)
+{
+	assert((child != NULL || parent != NULL) && "Cannot register an element that is neither child nor parent!");
+	if (child != NULL && child->registry != NULL)
+	{
+		return child->registry->GetHandle(child);
+	}
+	if (parent != NULL && parent->registry != NULL)
+	{
+		return parent->registry->GetHandle(parent);
+	}
+
+	unsigned int index = 0;
+	if (freeslots.size() > 0)
+	{
+		index = freeslots.back();
+		freeslots.pop_back();
+	}
+	else
+	{
+		assert(slots.size() <= INDEX_MASK && "Too many elements in one PowerCircuitManager!");
+		index = slots.size();
+		slots.push_back(REGISTRY_SLOT());
+	}
+
+	REGISTRY_SLOT &slot = slots[index];
+	slot.child = child;
+	slot.parent = parent;
+	slot.kinds = 0;
+	if (parent != NULL)
+	{
+		slot.kinds |= parent->GetParentType() == PPT_BUS ? PEK_BUS : PEK_SOURCE;
+		if (dynamic_cast<PowerSourceChargable*>(parent) != NULL)
+		{
+			slot.kinds |= PEK_CHARGABLE;
+		}
+	}
+	if (child != NULL && child->GetChildType() == PCT_CONSUMER)
+	{
+		slot.kinds |= PEK_CONSUMER;
+	}
+	POWER_HANDLE handle = (slot.generation << INDEX_BITS) | index;
+	if (child != NULL)
+	{
+		child->registry = this;
+		child->handle = handle;
+	}
+	if (parent != NULL)
+	{
+		parent->registry = this;
+		parent->handle = handle;
+	}
+	return handle;
+}
+
+
+void PowerElementRegistry::unregisterElement(POWER_HANDLE handle)
+{
+	REGISTRY_SLOT *slot = getSlot(handle);
+	assert(slot != NULL && "Attempting to unregister an element that is not registered!");
+
+	//both sides of the element know the handle, and both would try to unregister it when destroyed.
+	if (slot->child != NULL)
+	{
+		slot->child->registry = NULL;
+		slot->child->handle = 0;
+	}
+	if (slot->parent != NULL)
+	{
+		slot->parent->registry = NULL;
+		slot->parent->handle = 0;
+	}
+	slot->child = NULL;
+	slot->parent = NULL;
+	slot->kinds = 0;
+	slot->generation = (slot->generation + 1) & GENERATION_MASK;
+	if (slot->generation == 0)
+	{
+		slot->generation = 1;
+	}
+	freeslots.push_back(GetHandleIndex(handle));
+}
+
+
+void PowerElementRegistry::detachAll()
+{
+	for (unsigned int i = 0; i < slots.size(); ++i)
+	{
+		if (slots[i].child != NULL || slots[i].parent != NULL)
+		{
+			unregisterElement((slots[i].generation << INDEX_BITS) | i);
+		}
+	}
+}
+
+
+REGISTRY_SLOT *PowerElementRegistry::getSlot(POWER_HANDLE handle)
+{
+	unsigned int index = GetHandleIndex(handle);
+	if (handle == 0 || index >= slots.size() || slots[index].generation != (handle >> INDEX_BITS) ||
+		(slots[index].child == NULL && slots[index].parent == NULL))
+	{
+		return NULL;
+	}
+	return &slots[index];
+}
@@ -0,0 +1,169 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerConsumer.h"
+#include "PowerSource.h"
+#include "PowerSourceChargable.h"
+#include "PowerBus.h"
+#include "PowerEventQueue.h"
+#include "PowerEventStream.h"
+#include "PowerSolverState.h"
+#include "PowerElementRegistry.h"
+
+
+PowerEventQueue::PowerEventQueue(pmr::memory_resource *resource)
+	: records(resource), recorded(PEVT_COUNT, resource)
+{
+}
+
+
+PowerEventQueue::~PowerEventQueue()
+{
+}
+
+
+void PowerEventQueue::Raise(POWER_EVENT_TYPE type, void *element, double oldvalue)
+{
+	POWER_EVENT_RECORD record;
+	record.type = type;
+	record.element = element;
+	record.oldvalue = oldvalue;
+
+	if (!recording)
+	{
+		fire(record);
+	}
+	else if (recorded[type].insert(element).second)
+	{
+		//only the first change counts, we need the state from before the evaluation.
+		records.push_back(record);
+	}
+}
+
+
+bool PowerEventQueue::IsRecording()
+{
+	return recording;
+}
+
+
+void PowerEventQueue::startRecording()
+{
+	recording = true;
+}
+
+
+void PowerEventQueue::dispatch()
+{
+	//handlers run after recording stopped, so anything they change fires its events immediately.
+	recording = false;
+	for (unsigned int i = 0; i < PEVT_COUNT; ++i)
+	{
+		recorded[i].clear();
+	}
+
+	//handlers might cause new events, so work on a copy of the records.
+	pmr::vector<POWER_EVENT_RECORD> todispatch(records.get_allocator());
+	todispatch.swap(records);
+
+	for (auto i = todispatch.begin(); i != todispatch.end(); ++i)
+	{
+		fire((*i));
+	}
+
+	//keep the allocation around for the next evaluation.
+	todispatch.clear();
+	records.swap(todispatch);
+}
+
+
+void PowerEventQueue::fire(const POWER_EVENT_RECORD &record)
+{
+	if (stream != NULL)
+	{
+		writeToStream(record);
+	}
+
+	switch (record.type)
+	{
+	case PEVT_CHILD_SWITCH:
+		((PowerChild*)record.element)->fireChildSwitchEvent(record.oldvalue != 0);
+		break;
+	case PEVT_PARENT_SWITCH:
+		((PowerParent*)record.element)->fireParentSwitchEvent(record.oldvalue != 0);
+		break;
+	case PEVT_CONSUMER_RUNNING:
+		((PowerConsumer*)record.element)->fireRunningEvent(record.oldvalue != 0);
+		break;
+	case PEVT_CONSUMER_LOAD:
+		((PowerConsumer*)record.element)->fireConsumerLoadEvent(record.oldvalue);
+		break;
+	case PEVT_SOURCE_LOAD:
+		((PowerSource*)record.element)->fireSourceLoadEvent(record.oldvalue);
+		break;
+	case PEVT_BUS_CURRENT:
+		((PowerBus*)record.element)->fireCurrentEvents(record.oldvalue);
+		break;
+	case PEVT_CHARGE:
+		((PowerSourceChargable*)record.element)->fireChargeEvents(record.oldvalue);
+		break;
+	default:
+		assert(false && "Unknown event type!");
+	}
+}
+
+
+void PowerEventQueue::writeToStream(const POWER_EVENT_RECORD &record)
+{
+	POWER_EVENT_STREAM_RECORD streamrecord;
+	streamrecord.frame = stream->frame;
+	streamrecord.type = record.type;
+	streamrecord.oldvalue = record.oldvalue;
+	streamrecord.limit = 0;
+
+	//the stream identifies elements by their handle, no matter which of their classes declares the event.
+	POWER_HANDLE element = 0;
+	switch (record.type)
+	{
+	case PEVT_CHILD_SWITCH:
+		element = stream->registry->GetHandle((PowerChild*)record.element);
+		streamrecord.newvalue = ((PowerChild*)record.element)->IsChildSwitchedIn();
+		break;
+	case PEVT_PARENT_SWITCH:
+		element = stream->registry->GetHandle((PowerParent*)record.element);
+		streamrecord.newvalue = ((PowerParent*)record.element)->IsParentSwitchedIn();
+		break;
+	case PEVT_CONSUMER_RUNNING:
+		element = stream->registry->GetHandle((PowerConsumer*)record.element);
+		streamrecord.newvalue = ((PowerConsumer*)record.element)->IsRunning();
+		break;
+	case PEVT_CONSUMER_LOAD:
+		element = stream->registry->GetHandle((PowerConsumer*)record.element);
+		streamrecord.newvalue = ((PowerConsumer*)record.element)->GetConsumerLoad();
+		break;
+	case PEVT_SOURCE_LOAD:
+		element = stream->registry->GetHandle((PowerSource*)record.element);
+		streamrecord.newvalue = ((PowerSource*)record.element)->GetOutputCurrent();
+		break;
+	case PEVT_BUS_CURRENT:
+		element = stream->registry->GetHandle((PowerBus*)record.element);
+		streamrecord.newvalue = ((PowerBus*)record.element)->GetCurrent();
+		streamrecord.limit = ((PowerBus*)record.element)->GetMaxCurrent();
+		break;
+	case PEVT_CHARGE:
+		element = stream->registry->GetHandle((PowerSourceChargable*)record.element);
+		streamrecord.newvalue = ((PowerSourceChargable*)record.element)->GetCharge();
+		streamrecord.limit = ((PowerSourceChargable*)record.element)->chargablestate->lowchargelimit;
+		break;
+	default:
+		assert(false && "Unknown event type!");
+	}
+
+	//a state that changed back during evaluation is no event at all.
+	if (streamrecord.newvalue != streamrecord.oldvalue)
+	{
+		streamrecord.element = element;
+		stream->write(streamrecord);
+	}
+}
@@ -0,0 +1,70 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerEventStream.h"
+
+
+PowerEventStream::PowerEventStream(unsigned int capacity, PowerElementRegistry *registry)
+	: writeposition(0), readposition(0), overflowcount(0), registry(registry)
+{
+	//a power of two lets us wrap positions with a mask instead of a division.
+	this->capacity = 1;
+	while (this->capacity < capacity)
+	{
+		this->capacity <<= 1;
+	}
+	mask = this->capacity - 1;
+	records = new POWER_EVENT_STREAM_RECORD[this->capacity];
+}
+
+
+PowerEventStream::~PowerEventStream()
+{
+	delete[] records;
+}
+
+
+unsigned int PowerEventStream::Read(POWER_EVENT_STREAM_RECORD *OUT_records, unsigned int maxcount)
+{
+	unsigned long long read = readposition.load(memory_order_relaxed);
+	unsigned long long available = writeposition.load(memory_order_acquire) - read;
+	unsigned int count = (unsigned int)min((unsigned long long)maxcount, available);
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		OUT_records[i] = records[(read + i) & mask];
+	}
+	//release, so the simulation doesn't overwrite the records before we're done copying them.
+	readposition.store(read + count, memory_order_release);
+	return count;
+}
+
+
+unsigned long long PowerEventStream::GetOverflowCount()
+{
+	return overflowcount.load(memory_order_relaxed);
+}
+
+
+unsigned int PowerEventStream::GetCapacity()
+{
+	return capacity;
+}
+
+
+void PowerEventStream::write(const POWER_EVENT_STREAM_RECORD &record)
+{
+	unsigned long long write = writeposition.load(memory_order_relaxed);
+	if (write - cachedreadposition >= capacity)
+	{
+		//looks full, but the reader might have caught up in the meantime.
+		cachedreadposition = readposition.load(memory_order_acquire);
+		if (write - cachedreadposition >= capacity)
+		{
+			overflowcount.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	records[write & mask] = record;
+	writeposition.store(write + 1, memory_order_release);
+}
@@ -0,0 +1,448 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerSource.h"
+#include "PowerBus.h"
+#include "PowerTopologyBuilder.h"
+#include "PowerNodalSolver.h"
+#include "PowerSolverState.h"
+#include <queue>
+#include <iterator>
+
+
+PowerNodalSolver::PowerNodalSolver(pmr::memory_resource *resource)
+	: elements(resource), linkfirst(resource), linksecond(resource), linkresistances(resource), unknowns(resource), diagonals(resource),
+	  linkentries(resource), matrixoffsets(resource), matrixrows(resource), matrixvalues(resource), etree(resource), factoroffsets(resource),
+	  factorrows(resource), factorvalues(resource), diagonal(resource), solution(resource), potentials(resource), throughcurrents(resource)
+{
+}
+
+
+PowerNodalSolver::~PowerNodalSolver()
+{
+}
+
+
+void PowerNodalSolver::Analyze(TOPOLOGY_SNAPSHOT *snapshot)
+{
+	Clear();
+	sourcecount = snapshot->sources.size();
+	elements.assign(snapshot->sources.begin(), snapshot->sources.end());
+	elements.insert(elements.end(), snapshot->buses.begin(), snapshot->buses.end());
+	for (unsigned int i = 0; i < snapshot->buses.size(); ++i)
+	{
+		snapshot->buses[i]->reachabilityindex = i;
+	}
+
+	//every connection between two buses appears in the parents of both, but it's only one link.
+	unsigned int elementcount = elements.size();
+	for (unsigned int bus = 0; bus < snapshot->buses.size(); ++bus)
+	{
+		for (unsigned int i = snapshot->parentoffsets[bus]; i < snapshot->parentoffsets[bus + 1]; ++i)
+		{
+			if (snapshot->parents[i] < sourcecount + bus)
+			{
+				linkfirst.push_back(snapshot->parents[i]);
+				linksecond.push_back(sourcecount + bus);
+			}
+		}
+	}
+
+	//the potential of a node is only defined relative to another node. The first element of every group of connected elements
+	//is the reference of its group, and is left out of the matrix. Groups are found with a union-find over the links.
+	vector<unsigned int> groups(elementcount);
+	for (unsigned int i = 0; i < elementcount; ++i)
+	{
+		groups[i] = i;
+	}
+	auto findgroup = [&groups](unsigned int element)
+	{
+		while (groups[element] != element)
+		{
+			groups[element] = groups[groups[element]];
+			element = groups[element];
+		}
+		return element;
+	};
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		unsigned int first = findgroup(linkfirst[link]);
+		unsigned int second = findgroup(linksecond[link]);
+		if (first != second)
+		{
+			groups[max(first, second)] = min(first, second);
+		}
+	}
+
+	vector<int> indices(elementcount, -1);
+	unsigned int unknowncount = 0;
+	for (unsigned int i = 0; i < elementcount; ++i)
+	{
+		if (findgroup(i) != i)
+		{
+			indices[i] = unknowncount;
+			unknowncount++;
+		}
+	}
+	vector<vector<unsigned int>> adjacency(unknowncount);
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		int first = indices[linkfirst[link]];
+		int second = indices[linksecond[link]];
+		if (first >= 0 && second >= 0)
+		{
+			adjacency[first].push_back(second);
+			adjacency[second].push_back(first);
+		}
+	}
+	for (auto i = adjacency.begin(); i != adjacency.end(); ++i)
+	{
+		sort(i->begin(), i->end());
+		i->erase(unique(i->begin(), i->end()), i->end());
+	}
+	vector<unsigned int> order;
+	orderMinimumDegree(adjacency, order);
+	vector<unsigned int> positions(unknowncount);
+	for (unsigned int i = 0; i < unknowncount; ++i)
+	{
+		positions[order[i]] = i;
+	}
+	unknowns.assign(elementcount, -1);
+	for (unsigned int i = 0; i < elementcount; ++i)
+	{
+		if (indices[i] >= 0)
+		{
+			unknowns[i] = positions[indices[i]];
+		}
+	}
+
+	//lay out the upper triangle of the permuted matrix and remember where every link writes to.
+	vector<vector<unsigned int>> columns(unknowncount);
+	for (unsigned int i = 0; i < unknowncount; ++i)
+	{
+		columns[i].push_back(i);
+	}
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		int first = unknowns[linkfirst[link]];
+		int second = unknowns[linksecond[link]];
+		if (first >= 0 && second >= 0)
+		{
+			columns[max(first, second)].push_back(min(first, second));
+		}
+	}
+	matrixoffsets.push_back(0);
+	for (unsigned int i = 0; i < unknowncount; ++i)
+	{
+		sort(columns[i].begin(), columns[i].end());
+		columns[i].erase(unique(columns[i].begin(), columns[i].end()), columns[i].end());
+		matrixrows.insert(matrixrows.end(), columns[i].begin(), columns[i].end());
+		matrixoffsets.push_back(matrixrows.size());
+		//the diagonal has the highest row in its column.
+		diagonals.push_back(matrixrows.size() - 1);
+	}
+	matrixvalues.assign(matrixrows.size(), 0);
+	linkentries.assign(linkfirst.size(), -1);
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		int first = unknowns[linkfirst[link]];
+		int second = unknowns[linksecond[link]];
+		if (first >= 0 && second >= 0)
+		{
+			unsigned int column = max(first, second);
+			auto row = lower_bound(matrixrows.begin() + matrixoffsets[column], matrixrows.begin() + matrixoffsets[column + 1], (unsigned int)min(first, second));
+			linkentries[link] = row - matrixrows.begin();
+		}
+	}
+
+	analyzeFactor();
+	linkresistances.assign(linkfirst.size(), -1);
+	solution.assign(unknowncount, 0);
+	potentials.assign(elementcount, 0);
+	throughcurrents.assign(snapshot->buses.size(), 0);
+}
+
+
+void PowerNodalSolver::Clear()
+{
+	elements.clear();
+	sourcecount = 0;
+	linkfirst.clear();
+	linksecond.clear();
+	linkresistances.clear();
+	unknowns.clear();
+	diagonals.clear();
+	linkentries.clear();
+	matrixoffsets.clear();
+	matrixrows.clear();
+	matrixvalues.clear();
+	etree.clear();
+	factoroffsets.clear();
+	factorrows.clear();
+	factorvalues.clear();
+	diagonal.clear();
+	solution.clear();
+	potentials.clear();
+	throughcurrents.clear();
+	factorizations = 0;
+	factorized = false;
+}
+
+
+void PowerNodalSolver::orderMinimumDegree(vector<vector<unsigned int>> &adjacency, vector<unsigned int> &OUT_order)
+{
+	unsigned int count = adjacency.size();
+	vector<unsigned char> eliminated(count, 0);
+	//entries go stale when the degree of their node changes, they are skipped when they come up.
+	priority_queue<pair<unsigned int, unsigned int>, vector<pair<unsigned int, unsigned int>>, greater<pair<unsigned int, unsigned int>>> candidates;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		candidates.push(make_pair((unsigned int)adjacency[i].size(), i));
+	}
+	vector<unsigned int> merged;
+	while (candidates.size() > 0)
+	{
+		unsigned int degree = candidates.top().first;
+		unsigned int node = candidates.top().second;
+		candidates.pop();
+		if (eliminated[node] || degree != adjacency[node].size())
+		{
+			continue;
+		}
+		eliminated[node] = 1;
+		OUT_order.push_back(node);
+
+		//eliminating a node connects all of its neighbours with each other.
+		const vector<unsigned int> &neighbours = adjacency[node];
+		for (auto i = neighbours.begin(); i != neighbours.end(); ++i)
+		{
+			vector<unsigned int> &list = adjacency[(*i)];
+			merged.clear();
+			set_union(list.begin(), list.end(), neighbours.begin(), neighbours.end(), back_inserter(merged));
+			merged.erase(remove_if(merged.begin(), merged.end(), [&](unsigned int n) { return n == node || n == (*i); }), merged.end());
+			list.swap(merged);
+			candidates.push(make_pair((unsigned int)list.size(), (*i)));
+		}
+		adjacency[node].clear();
+	}
+}
+
+
+void PowerNodalSolver::analyzeFactor()
+{
+	//the pattern of column k of L is found by walking up the elimination tree from the rows of column k of the matrix.
+	unsigned int count = diagonals.size();
+	etree.assign(count, -1);
+	vector<unsigned int> counts(count, 0);
+	vector<unsigned int> flags(count);
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		flags[k] = k;
+		for (unsigned int p = matrixoffsets[k]; p < matrixoffsets[k + 1]; ++p)
+		{
+			for (unsigned int i = matrixrows[p]; flags[i] != k; i = etree[i])
+			{
+				if (etree[i] == -1)
+				{
+					etree[i] = k;
+				}
+				counts[i]++;
+				flags[i] = k;
+			}
+		}
+	}
+	factoroffsets.assign(count + 1, 0);
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		factoroffsets[k + 1] = factoroffsets[k] + counts[k];
+	}
+	factorrows.assign(factoroffsets[count], 0);
+	factorvalues.assign(factoroffsets[count], 0);
+	diagonal.assign(count, 0);
+}
+
+
+void PowerNodalSolver::factorize()
+{
+	fill(matrixvalues.begin(), matrixvalues.end(), 0.0);
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		double conductance = 1 / linkresistances[link];
+		int first = unknowns[linkfirst[link]];
+		int second = unknowns[linksecond[link]];
+		if (first >= 0) matrixvalues[diagonals[first]] += conductance;
+		if (second >= 0) matrixvalues[diagonals[second]] += conductance;
+		if (linkentries[link] >= 0) matrixvalues[linkentries[link]] -= conductance;
+	}
+
+	//up-looking LDL^T: row k of L is the solution of a triangular system with the pattern given by the elimination tree.
+	unsigned int count = diagonals.size();
+	pmr::memory_resource *resource = elements.get_allocator().resource();
+	pmr::vector<double> row(count, 0, resource);
+	pmr::vector<unsigned int> pattern(count, 0, resource);
+	pmr::vector<unsigned int> flags(count, 0, resource);
+	pmr::vector<unsigned int> filled(count, 0, resource);
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		unsigned int top = count;
+		flags[k] = k;
+		for (unsigned int p = matrixoffsets[k]; p < matrixoffsets[k + 1]; ++p)
+		{
+			unsigned int i = matrixrows[p];
+			row[i] += matrixvalues[p];
+			unsigned int length = 0;
+			for (; flags[i] != k; i = etree[i])
+			{
+				pattern[length] = i;
+				length++;
+				flags[i] = k;
+			}
+			while (length > 0)
+			{
+				top--;
+				length--;
+				pattern[top] = pattern[length];
+			}
+		}
+		diagonal[k] = row[k];
+		row[k] = 0;
+		for (; top < count; ++top)
+		{
+			unsigned int i = pattern[top];
+			double value = row[i];
+			row[i] = 0;
+			unsigned int end = factoroffsets[i] + filled[i];
+			for (unsigned int p = factoroffsets[i]; p < end; ++p)
+			{
+				row[factorrows[p]] -= factorvalues[p] * value;
+			}
+			double factor = value / diagonal[i];
+			diagonal[k] -= factor * value;
+			factorrows[end] = k;
+			factorvalues[end] = factor;
+			filled[i]++;
+		}
+		assert(diagonal[k] > 0 && "Conductance matrix is not positive definite!");
+	}
+	factorizations++;
+	factorized = true;
+}
+
+
+void PowerNodalSolver::Update(double voltage)
+{
+	bool resistancechanged = !factorized;
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		double resistance = getLinkResistance(link);
+		if (resistance != linkresistances[link])
+		{
+			linkresistances[link] = resistance;
+			resistancechanged = true;
+		}
+	}
+	if (resistancechanged)
+	{
+		factorize();
+	}
+
+	fill(solution.begin(), solution.end(), 0.0);
+	for (unsigned int i = 0; i < elements.size(); ++i)
+	{
+		if (unknowns[i] < 0)
+		{
+			//whatever goes into a reference node is balanced by the rest of its group.
+			continue;
+		}
+		if (i < sourcecount)
+		{
+			solution[unknowns[i]] += ((PowerSource*)elements[i])->sourcestate->outputcurrent;
+		}
+		else
+		{
+			double busresistance = ((PowerBus*)elements[i])->busstate->equivalentresistance;
+			solution[unknowns[i]] -= busresistance > 0 ? voltage / busresistance : 0;
+		}
+	}
+
+	//L * D * L^T * x = b
+	unsigned int count = diagonals.size();
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		for (unsigned int p = factoroffsets[k]; p < factoroffsets[k + 1]; ++p)
+		{
+			solution[factorrows[p]] -= factorvalues[p] * solution[k];
+		}
+	}
+	for (unsigned int k = 0; k < count; ++k)
+	{
+		solution[k] /= diagonal[k];
+	}
+	for (unsigned int k = count; k > 0; --k)
+	{
+		for (unsigned int p = factoroffsets[k - 1]; p < factoroffsets[k]; ++p)
+		{
+			solution[k - 1] -= factorvalues[p] * solution[factorrows[p]];
+		}
+	}
+	for (unsigned int i = 0; i < elements.size(); ++i)
+	{
+		potentials[i] = unknowns[i] >= 0 ? solution[unknowns[i]] : 0;
+	}
+
+	//the current through a bus is everything flowing into it.
+	fill(throughcurrents.begin(), throughcurrents.end(), 0.0);
+	for (unsigned int link = 0; link < linkfirst.size(); ++link)
+	{
+		double current = (potentials[linkfirst[link]] - potentials[linksecond[link]]) / linkresistances[link];
+		if (current > 0)
+		{
+			throughcurrents[linksecond[link] - sourcecount] += current;
+		}
+		else if (linkfirst[link] >= sourcecount)
+		{
+			throughcurrents[linkfirst[link] - sourcecount] -= current;
+		}
+	}
+}
+
+
+double PowerNodalSolver::getLinkResistance(unsigned int link)
+{
+	double resistance = ((PowerBus*)elements[linksecond[link]])->busstate->resistance;
+	if (linkfirst[link] >= sourcecount)
+	{
+		resistance += ((PowerBus*)elements[linkfirst[link]])->busstate->resistance;
+	}
+	return max(resistance, MIN_LINK_RESISTANCE);
+}
+
+
+double PowerNodalSolver::GetThroughCurrent(PowerBus *bus)
+{
+	unsigned int index = bus->reachabilityindex;
+	if (index < throughcurrents.size() && elements[sourcecount + index] == bus)
+	{
+		return throughcurrents[index];
+	}
+	return 0;
+}
+
+
+unsigned int PowerNodalSolver::GetLinkCount()
+{
+	return linkfirst.size();
+}
+
+
+unsigned int PowerNodalSolver::GetFactorSize()
+{
+	return factorrows.size();
+}
+
+
+unsigned int PowerNodalSolver::GetFactorizationCount()
+{
+	return factorizations;
+}
@@ -4,19 +4,33 @@
 #include "PowerChild.h"
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
-#include "PowerSubCircuit.h"
+#include "PowerCircuitManager.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
+#include "PowerElementRegistry.h"
+#include "PowerReachabilityTable.h"
 
-PowerParent::PowerParent(POWERPARENT_TYPE type, double minvoltage, double maxvoltage, bool switchable)
-	: parenttype(type), parentcanswitch(switchable)
+PowerParent::PowerParent(POWERPARENT_TYPE type, double minvoltage, double maxvoltage, bool switchable, pmr::memory_resource *resource)
+	: children(resource), reachabilitytables(resource), parenttype(type), parentcanswitch(switchable)
 
 { 
-	outputvoltage.minimum = minvoltage;
-	outputvoltage.maximum = maxvoltage;
+	outputvoltagerange.minimum = minvoltage;
+	outputvoltagerange.maximum = maxvoltage;
 };
 
 PowerParent::~PowerParent()
 {
-
+	//tables may outlive the structure they were built for while a rebuild is pending, so they must not keep pointing here.
+	for (auto i = reachabilitytables.begin(); i != reachabilitytables.end(); ++i)
+	{
+		(*i)->RemoveElement(this);
+	}
+	if (registry != NULL)
+	{
+		registry->unregisterElement(handle);
+	}
+	delete parentsubscriptions;
 }
 
 
@@ -25,7 +39,7 @@ bool PowerParent::CanConnectToChild(PowerChild *child, bool bidirectional)
 	//the base conditions are that the child is not yet connected, 
 	//and that the voltages of parent and child are compatible.
 	if (find(children.begin(), children.end(), child) == children.end() &&
-		outputvoltage.IsRangeCompatibleWith(child->GetInputVoltageInfo()))
+		outputvoltagerange.IsRangeCompatibleWith(child->GetInputVoltageInfo()))
 	{
 		if (bidirectional)
 		{
@@ -38,23 +52,30 @@ bool PowerParent::CanConnectToChild(PowerChild *child, bool bidirectional)
 
 void PowerParent::GetChildren(vector<PowerChild*> &OUT_children)
 {
-	OUT_children = children;
+	OUT_children.assign(children.begin(), children.end());
+}
+
+PowerSpan<PowerChild*> PowerParent::GetChildren()
+{
+	return PowerSpan<PowerChild*>(children.begin(), children.size());
 }
 
 VOLTAGE_INFO PowerParent::GetOutputVoltageInfo()
 {
+	VOLTAGE_INFO outputvoltage = outputvoltagerange;
+	outputvoltage.current = parentstate->voltage;
 	return outputvoltage;
 }
 
 double PowerParent::GetCurrentOutputVoltage()
 {
-	return outputvoltage.current;
+	return parentstate->voltage;
 }
 
 
 bool PowerParent::IsParentSwitchedIn() 
 { 
-	return parentswitchedin; 
+	return parentstate->switchedin; 
 }
 
 bool PowerParent::IsParentSwitchable()
@@ -64,26 +85,34 @@ bool PowerParent::IsParentSwitchable()
 
 void PowerParent::SetParentSwitchedIn(bool switchedin) 
 { 
-	if (parentcanswitch && switchedin != parentswitchedin)
+	if (parentcanswitch && switchedin != parentstate->switchedin)
 	{
-		parentswitchedin = switchedin;
-		circuit->RegisterStateChange();
-		if (parentSwitchIn && switchedin) parentSwitchIn(this);
-		else if (parentSwitchOut && !switchedin) parentSwitchOut(this);
+		bool wasswitchedin = parentstate->switchedin;
+		parentstate->switchedin = switchedin;
+		parentstate->circuit->RegisterStateChange();
+		PowerEventQueue *eventqueue = getEventQueue();
+		if (eventqueue != NULL)
+		{
+			eventqueue->Raise(PEVT_PARENT_SWITCH, this, wasswitchedin);
+		}
+		else
+		{
+			fireParentSwitchEvent(wasswitchedin);
+		}
 	}
 	
 }
 
 bool PowerParent::IsAutoswitchEnabled() 
 { 
-	return parentautoswitch; 
+	return parentstate->autoswitch; 
 }
 
 void PowerParent::SetAutoswitchEnabled(bool enabled) 
 { 
-	if (enabled != parentautoswitch)
+	if (enabled != parentstate->autoswitch)
 	{
-		parentautoswitch = enabled;
+		parentstate->autoswitch = enabled;
 		RegisterChildStateChange();
 	}
 }
@@ -91,15 +120,13 @@ void PowerParent::SetAutoswitchEnabled(bool enabled)
 
 void PowerParent::RegisterChildStateChange() 
 { 
-	child_state_changed = true;
-	if (circuit != NULL)
+	parentstate->childstatechanged = true;
+	//reachability tables indexing this parent notice the new generation when they are updated, so there's no need to notify them.
+	parentstate->generation++;
+	if (parentstate->circuit != NULL)
 	{
 		//parents can sometimes be connected to children without being part of a circuit.
-		circuit->RegisterStateChange();
-	}
-	for (auto i = containing_subcircuits.begin(); i != containing_subcircuits.end(); ++i)
-	{
-		(*i)->RegisterStateChange();
+		parentstate->circuit->RegisterStateChange();
 	}
 }
 
@@ -110,32 +137,32 @@ POWERPARENT_TYPE PowerParent::GetParentType()
 
 void PowerParent::SetCircuitToNull()
 {
-	circuit = NULL;
+	parentstate->circuit = NULL;
 }
 
 void PowerParent::SetCircuit(PowerCircuit *circuit)
 {
 	assert(circuit != NULL && "NULL-circuit passed to SetCircuit()! Use SetCircuitToNull() instead!");
-	this->circuit = circuit;
+	parentstate->circuit = circuit;
 }
 
 PowerCircuit *PowerParent::GetCircuit()
 {
-	return circuit;
+	return parentstate->circuit;
 }
 
-void PowerParent::RegisterContainingSubCircuit(PowerSubCircuit *subcircuit)
+void PowerParent::RegisterReachabilityTable(PowerReachabilityTable *table)
 {
-	assert(find(containing_subcircuits.begin(), containing_subcircuits.end(), subcircuit) == containing_subcircuits.end()
-		&& "Attempting to register already registered subcircuit!");
-	containing_subcircuits.push_back(subcircuit);
+	assert(find(reachabilitytables.begin(), reachabilitytables.end(), table) == reachabilitytables.end()
+		&& "Attempting to register already registered reachability table!");
+	reachabilitytables.push_back(table);
 }
 
-void PowerParent::UnregisterContainingSubCircuit(PowerSubCircuit *subcircuit)
+void PowerParent::UnregisterReachabilityTable(PowerReachabilityTable *table)
 {
-	auto unregistercircuit = find(containing_subcircuits.begin(), containing_subcircuits.end(), subcircuit);
-	assert(unregistercircuit != containing_subcircuits.end() && "Attempting to unregister subcircuit that was not registered!");
-	containing_subcircuits.erase(unregistercircuit);
+	auto unregistertable = find(reachabilitytables.begin(), reachabilitytables.end(), table);
+	assert(unregistertable != reachabilitytables.end() && "Attempting to unregister reachability table that was not registered!");
+	reachabilitytables.erase(unregistertable);
 }
 
 
@@ -162,4 +189,56 @@ void PowerParent::DisconnectParentFromChild(PowerChild *child, bool bidirectiona
 	{
 		child->DisconnectChildFromParent(this, false);
 	}
+}
+
+
+PowerEventQueue *PowerParent::getEventQueue()
+{
+	if (parentstate->circuit == NULL)
+	{
+		return NULL;
+	}
+	return parentstate->circuit->GetCircuitManager()->GetEventQueue();
+}
+
+void PowerParent::fireParentSwitchEvent(bool wasswitchedin)
+{
+	if (parentstate->switchedin == wasswitchedin)
+	{
+		return;
+	}
+	if (parentsubscriptions == NULL)
+	{
+		return;
+	}
+	if (parentstate->switchedin) parentsubscriptions->switchin.Invoke(this);
+	else parentsubscriptions->switchout.Invoke(this);
+}
+
+
+unsigned int PowerParent::OnParentSwitchIn(function<void(PowerParent*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->switchin, lambda);
+}
+
+unsigned int PowerParent::OnParentSwitchOut(function<void(PowerParent*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->switchout, lambda);
+}
+
+
+bool PowerParent::RemoveParentEventHandler(unsigned int id)
+{
+	return parentsubscriptions != NULL && parentsubscriptions->Remove(id);
+}
+
+PARENT_SUBSCRIPTIONS *PowerParent::getParentSubscriptions()
+{
+	if (parentsubscriptions == NULL)
+	{
+		parentsubscriptions = new PARENT_SUBSCRIPTIONS;
+	}
+	return parentsubscriptions;
 }
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerSource.h"
+#include "PowerBus.h"
+#include "PowerTopologyBuilder.h"
+#include "PowerReachabilityTable.h"
+#include "PowerSolverState.h"
+
+
+PowerReachabilityTable::PowerReachabilityTable(pmr::memory_resource *resource)
+	: elements(resource), contributions(resource), generations(resource), edgeoffsets(resource), masks(resource),
+	  maskedges(resource), edgebases(resource), edgeelements(resource), derivedorder(resource),
+	  edgebuses(resource), edgesurpluses(resource), throughcurrents(resource), dirtybuses(resource)
+{
+}
+
+
+PowerReachabilityTable::~PowerReachabilityTable()
+{
+	Clear();
+}
+
+
+void PowerReachabilityTable::Assign(TOPOLOGY_RESULT *result, double voltage)
+{
+	Clear();
+	this->voltage = voltage;
+	sourcecount = result->sources.size();
+	elements.assign(result->sources.begin(), result->sources.end());
+	elements.insert(elements.end(), result->buses.begin(), result->buses.end());
+	for (unsigned int i = 0; i < elements.size(); ++i)
+	{
+		elements[i]->RegisterReachabilityTable(this);
+	}
+	for (unsigned int i = 0; i < result->buses.size(); ++i)
+	{
+		result->buses[i]->reachabilityindex = i;
+	}
+
+	contributions.assign(elements.size(), 0);
+	generations.assign(elements.size(), 0);
+	edgeoffsets.assign(result->edgeoffsets.begin(), result->edgeoffsets.end());
+	masks.assign(result->masks.begin(), result->masks.end());
+	maskwords = result->maskwords;
+	maskedges.clear();
+	for (unsigned int edge = 0; edge < result->edgemasks.size(); ++edge)
+	{
+		if (result->edgemasks[edge] >= 0)
+		{
+			assert(result->edgemasks[edge] == (int)maskedges.size() && "Masks must be in the order of their edges!");
+			maskedges.push_back(edge);
+		}
+	}
+	edgebases.assign(result->edgebases.begin(), result->edgebases.end());
+	edgeelements.assign(result->edgeelements.begin(), result->edgeelements.end());
+	derivedorder.assign(result->derivedorder.begin(), result->derivedorder.end());
+	edgebuses.clear();
+	for (unsigned int bus = 0; bus < result->buses.size(); ++bus)
+	{
+		edgebuses.insert(edgebuses.end(), edgeoffsets[bus + 1] - edgeoffsets[bus], bus);
+	}
+	edgesurpluses.assign(edgebuses.size(), 0);
+	throughcurrents.assign(result->buses.size(), 0);
+	dirtybuses.assign(result->buses.size(), 0);
+	stale = true;
+}
+
+
+void PowerReachabilityTable::Clear()
+{
+	for (auto i = elements.begin(); i != elements.end(); ++i)
+	{
+		if ((*i) != NULL)
+		{
+			(*i)->UnregisterReachabilityTable(this);
+		}
+	}
+	elements.clear();
+	sourcecount = 0;
+	contributions.clear();
+	generations.clear();
+	edgeoffsets.clear();
+	masks.clear();
+	maskwords = 0;
+	maskedges.clear();
+	edgebases.clear();
+	edgeelements.clear();
+	derivedorder.clear();
+	edgebuses.clear();
+	edgesurpluses.clear();
+	throughcurrents.clear();
+	dirtybuses.clear();
+}
+
+
+void PowerReachabilityTable::Update()
+{
+	if (updatessinceresync >= RESYNC_INTERVAL)
+	{
+		stale = true;
+	}
+
+	//only elements whose generation changed can have a different contribution.
+	bool changed = false;
+	for (unsigned int i = 0; i < elements.size(); ++i)
+	{
+		if (elements[i] == NULL || (!stale && elements[i]->parentstate->generation == generations[i]))
+		{
+			continue;
+		}
+		generations[i] = elements[i]->parentstate->generation;
+		double contribution = 0;
+		if (i < sourcecount)
+		{
+			contribution = ((PowerSource*)elements[i])->sourcestate->outputcurrent;
+		}
+		else
+		{
+			//just because there are no consumers running on one bus doesn't mean there's a short-circuit. That would only be the case if nothing at all is running in the whole circuit.
+			//dividing by zero would non the less provide for a little code short-circuit of our own...
+			double busresistance = ((PowerBus*)elements[i])->busstate->equivalentresistance;
+			contribution = busresistance > 0 ? -voltage / busresistance : 0;
+		}
+		if (contribution != contributions[i])
+		{
+			if (!stale)
+			{
+				pushDelta(i, contribution - contributions[i]);
+			}
+			contributions[i] = contribution;
+			changed = true;
+		}
+	}
+
+	if (stale)
+	{
+		recalculateAll();
+	}
+	else if (changed)
+	{
+		recalculateDerived();
+		for (unsigned int bus = 0; bus < dirtybuses.size(); ++bus)
+		{
+			if (dirtybuses[bus])
+			{
+				recalculateThroughCurrent(bus);
+				dirtybuses[bus] = 0;
+			}
+		}
+		updatessinceresync++;
+	}
+}
+
+
+void PowerReachabilityTable::recalculateAll()
+{
+	for (unsigned int mask = 0; mask < maskedges.size(); ++mask)
+	{
+		edgesurpluses[maskedges[mask]] = maskedSum(masks.data() + mask * maskwords);
+	}
+	recalculateDerived();
+	for (unsigned int bus = 0; bus < throughcurrents.size(); ++bus)
+	{
+		recalculateThroughCurrent(bus);
+		dirtybuses[bus] = 0;
+	}
+	updatessinceresync = 0;
+	stale = false;
+}
+
+
+void PowerReachabilityTable::pushDelta(unsigned int element, double delta)
+{
+	unsigned int word = element / BITS_PER_WORD;
+	unsigned long long bit = 1ull << (element % BITS_PER_WORD);
+	for (unsigned int mask = 0; mask < maskedges.size(); ++mask)
+	{
+		if ((masks[mask * maskwords + word] & bit) != 0)
+		{
+			unsigned int edge = maskedges[mask];
+			edgesurpluses[edge] += delta;
+			dirtybuses[edgebuses[edge]] = 1;
+		}
+	}
+}
+
+
+void PowerReachabilityTable::recalculateDerived()
+{
+	for (auto i = derivedorder.begin(); i != derivedorder.end(); ++i)
+	{
+		int base = edgebases[(*i)];
+		double surplus = (base >= 0 ? edgesurpluses[base] : 0) + contributions[edgeelements[(*i)]];
+		if (surplus != edgesurpluses[(*i)])
+		{
+			edgesurpluses[(*i)] = surplus;
+			dirtybuses[edgebuses[(*i)]] = 1;
+		}
+	}
+}
+
+
+void PowerReachabilityTable::recalculateThroughCurrent(unsigned int bus)
+{
+	//the current flowing through a bus is really just the current surplus of all feeding edges.
+	double current = 0;
+	for (unsigned int edge = edgeoffsets[bus]; edge < edgeoffsets[bus + 1]; ++edge)
+	{
+		current += max(0.0, edgesurpluses[edge]);
+	}
+	throughcurrents[bus] = current;
+}
+
+
+double PowerReachabilityTable::maskedSum(const unsigned long long *mask)
+{
+	double sum = 0;
+	unsigned int count = contributions.size();
+	for (unsigned int word = 0; word < maskwords; ++word)
+	{
+		unsigned long long bits = mask[word];
+		if (bits == 0)
+		{
+			continue;
+		}
+		//branch free, so the compiler can vectorise the inner loop.
+		const double *values = contributions.data() + word * BITS_PER_WORD;
+		unsigned int valuecount = min(BITS_PER_WORD, count - word * BITS_PER_WORD);
+		for (unsigned int bit = 0; bit < valuecount; ++bit)
+		{
+			sum += ((bits >> bit) & 1) ? values[bit] : 0.0;
+		}
+	}
+	return sum;
+}
+
+
+double PowerReachabilityTable::GetThroughCurrent(PowerBus *bus)
+{
+	unsigned int index = bus->reachabilityindex;
+	if (index < throughcurrents.size() && elements[sourcecount + index] == bus)
+	{
+		return throughcurrents[index];
+	}
+	return 0;
+}
+
+
+void PowerReachabilityTable::RemoveElement(PowerParent *element)
+{
+	auto i = find(elements.begin(), elements.end(), element);
+	assert(i != elements.end() && "Attempting to remove an element that is not in the table!");
+	unsigned int index = i - elements.begin();
+	elements[index] = NULL;
+	contributions[index] = 0;
+	stale = true;
+}
+
+
+unsigned int PowerReachabilityTable::GetEdgeCount()
+{
+	return edgeoffsets.size() > 0 ? edgeoffsets.back() : 0;
+}
+
+
+unsigned int PowerReachabilityTable::GetDerivedEdgeCount()
+{
+	return derivedorder.size();
+}
+
+
+unsigned int PowerReachabilityTable::GetMaskSize()
+{
+	return masks.size() * sizeof(unsigned long long);
+}
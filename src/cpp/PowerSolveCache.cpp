@@ -0,0 +1,96 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerSolveCache.h"
+#include <cstring>
+
+
+PowerSolveCache::PowerSolveCache(pmr::memory_resource *resource, unsigned int capacity)
+	: entries(resource), key(resource)
+{
+	entries.reserve(capacity);
+	for (unsigned int i = 0; i < capacity; ++i)
+	{
+		entries.emplace_back(resource);
+	}
+}
+
+
+pmr::vector<double> &PowerSolveCache::BeginKey()
+{
+	key.clear();
+	return key;
+}
+
+
+SOLVE_CACHE_ENTRY *PowerSolveCache::Find()
+{
+	unsigned long long hash = hashKey();
+	for (auto i = entries.begin(); i != entries.end(); ++i)
+	{
+		if (i->valid && i->hash == hash && i->key == key)
+		{
+			clock++;
+			i->lastused = clock;
+			hits++;
+			return &(*i);
+		}
+	}
+	return NULL;
+}
+
+
+SOLVE_CACHE_ENTRY *PowerSolveCache::Store()
+{
+	SOLVE_CACHE_ENTRY *entry = &entries[0];
+	for (auto i = entries.begin(); i != entries.end(); ++i)
+	{
+		if (!i->valid)
+		{
+			entry = &(*i);
+			break;
+		}
+		if (i->lastused < entry->lastused)
+		{
+			entry = &(*i);
+		}
+	}
+	clock++;
+	entry->lastused = clock;
+	entry->hash = hashKey();
+	entry->key.assign(key.begin(), key.end());
+	entry->valid = true;
+	return entry;
+}
+
+
+void PowerSolveCache::Clear()
+{
+	for (auto i = entries.begin(); i != entries.end(); ++i)
+	{
+		i->valid = false;
+	}
+}
+
+
+unsigned int PowerSolveCache::GetHitCount()
+{
+	return hits;
+}
+
+
+unsigned long long PowerSolveCache::hashKey()
+{
+	//FNV-1a over the bits of the key.
+	unsigned long long hash = 14695981039346656037ull;
+	for (auto i = key.begin(); i != key.end(); ++i)
+	{
+		unsigned long long bits;
+		memcpy(&bits, &(*i), sizeof(bits));
+		for (unsigned int byte = 0; byte < sizeof(bits); ++byte)
+		{
+			hash ^= (bits >> (byte * 8)) & 0xff;
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
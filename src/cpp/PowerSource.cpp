@@ -6,49 +6,55 @@
 #include "PowerSource.h"
 #include "PowerCircuit_Base.h"
 #include "PowerCircuit.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
 
-PowerSource::PowerSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global)
-	: PowerParent(POWERPARENT_TYPE::PPT_SOURCE, minvoltage, maxvoltage), internalresistance(internalresistance), maxpowerout(maxpower), locationid(location_id), global(global)
+PowerSource::PowerSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global, pmr::memory_resource *resource)
+	: PowerParent(POWERPARENT_TYPE::PPT_SOURCE, minvoltage, maxvoltage, true, resource), locationid(location_id), global(global)
 {
-	
+	sourcestate = PowerStateTable<SOURCE_SOLVER_STATE>::Get().Allocate();
+	parentstate = &sourcestate->parent;
+	sourcestate->maxpower = maxpower;
+	sourcestate->internalresistance = internalresistance;
 }
 
 PowerSource::~PowerSource()
 {
-
+	PowerStateTable<SOURCE_SOLVER_STATE>::Get().Free(sourcestate);
 }
 
 
 double PowerSource::GetMaxPowerOutput()
 {
-	return maxpowerout;
+	return sourcestate->maxpower;
 }
 
 double PowerSource::GetCurrentPowerOutput()
 {
-	return outputvoltage.current * curroutputcurrent;
+	return parentstate->voltage * sourcestate->outputcurrent;
 }
 
 
 double PowerSource::GetInternalResistance()
 {
-	return internalresistance;
+	return sourcestate->internalresistance;
 }
 
 double PowerSource::GetOutputCurrent()
 {
-	return curroutputcurrent;
+	return sourcestate->outputcurrent;
 }
 
 
 double PowerSource::GetMaxOutputCurrent(bool force)
 {
-	if (parentswitchedin ||
-		(force && parentautoswitch))
+	if (parentstate->switchedin ||
+		(force && parentstate->autoswitch))
 	{
 		//Communicate maximum power output if switched into the circuit,
 		//or if reply is forced and autoswitch is enabled.
-		return maxoutcurrent;
+		return sourcestate->maxoutputcurrent;
 	}
 	else
 	{
@@ -60,24 +66,33 @@ double PowerSource::GetMaxOutputCurrent(bool force)
 void PowerSource::SetRequestedCurrent(double amps)
 {
 	//if more amps are requested than can be delivered, the circuit screwed up badly!
-	assert(amps <= maxoutcurrent && "Requested more current than can be delivered!");
-	if (amps != curroutputcurrent)
+	assert(amps <= sourcestate->maxoutputcurrent && "Requested more current than can be delivered!");
+	if (amps != sourcestate->outputcurrent)
 	{
-		curroutputcurrent = amps;
+		double oldcurrent = sourcestate->outputcurrent;
+		sourcestate->outputcurrent = amps;
 		RegisterChildStateChange();
-		if (loadChange) loadChange(this);
+		PowerEventQueue *eventqueue = getEventQueue();
+		if (eventqueue != NULL)
+		{
+			eventqueue->Raise(PEVT_SOURCE_LOAD, this, oldcurrent);
+		}
+		else
+		{
+			fireSourceLoadEvent(oldcurrent);
+		}
 	}
 }
 
 void PowerSource::SetMaxPowerOutput(double watts)
 {
-	if (watts != maxpowerout)
+	if (watts != sourcestate->maxpower)
 	{
-		maxpowerout = watts;
-		maxoutcurrent = maxpowerout / outputvoltage.current;
-		if (curroutputcurrent > maxoutcurrent)
+		sourcestate->maxpower = watts;
+		sourcestate->maxoutputcurrent = sourcestate->maxpower / parentstate->voltage;
+		if (sourcestate->outputcurrent > sourcestate->maxoutputcurrent)
 		{
-			curroutputcurrent = maxoutcurrent;
+			sourcestate->outputcurrent = sourcestate->maxoutputcurrent;
 			RegisterChildStateChange();
 		}
 	}
@@ -109,17 +124,17 @@ void PowerSource::ConnectParentToChild(PowerChild *child, bool bidirectional)
 	PowerParent::ConnectParentToChild(child, bidirectional);
 
 	//comply to the childs input power. Tests for compatibility were already done at this point.
-	outputvoltage.current = child->GetCurrentInputVoltage();
-	maxoutcurrent = maxpowerout / outputvoltage.current;
-	curroutputcurrent = 0;
+	parentstate->voltage = child->GetCurrentInputVoltage();
+	sourcestate->maxoutputcurrent = sourcestate->maxpower / parentstate->voltage;
+	sourcestate->outputcurrent = 0;
 	RegisterChildStateChange();
 }
 
 void PowerSource::SetCircuitToNull()
 {
 	//the source is removed from a circuit, shut it down!
-	circuit = NULL;
-	curroutputcurrent = 0;
+	parentstate->circuit = NULL;
+	sourcestate->outputcurrent = 0;
 }
 
 
@@ -133,3 +148,15 @@ bool PowerSource::IsGlobal()
 	return global;
 }
 
+
+void PowerSource::fireSourceLoadEvent(double oldcurrent)
+{
+	if (sourcestate->outputcurrent != oldcurrent && parentsubscriptions != NULL) parentsubscriptions->loadchanged.Invoke(this);
+}
+
+
+unsigned int PowerSource::OnLoadChanged(function<void(PowerSource*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->loadchanged, lambda);
+}
@@ -7,6 +7,9 @@
 #include "PowerSourceChargable.h"
 
 #include "PowerBus.h"
+#include "PowerEventQueue.h"
+#include "PowerEventSubscriptions.h"
+#include "PowerSolverState.h"
 
 
 PowerSourceChargable::PowerSourceChargable(double minvoltage,
@@ -18,46 +21,53 @@ PowerSourceChargable::PowerSourceChargable(double minvoltage,
                                            double internalresistance,
                                            unsigned int location_id,
                                            double minimumchargingload,
-                                           bool global)
-	: PowerSource(minvoltage, maxvoltage, maxdischarge, internalresistance, location_id, global), 
-	  PowerConsumer(minvoltage, maxvoltage, maxchargingpower, location_id, 0, minimumchargingload, global),
-	  maxcharge(charge), charge(charge), efficiency(chargingefficiency), lowchargelimit(maxcharge * 0.1)
+                                           bool global,
+                                           pmr::memory_resource *resource)
+	: PowerSource(minvoltage, maxvoltage, maxdischarge, internalresistance, location_id, global, resource), 
+	  PowerConsumer(minvoltage, maxvoltage, maxchargingpower, location_id, 0, minimumchargingload, global, resource)
 {
+	chargablestate = PowerStateTable<CHARGABLE_SOLVER_STATE>::Get().Allocate();
+	chargablestate->maxcharge = charge;
+	chargablestate->charge = charge;
+	chargablestate->efficiency = chargingefficiency;
+	chargablestate->lowchargelimit = charge * 0.1;
+
 	//for a chargable powersource it makes sense to initialise it as providing and with autoswitch enabled.
-	childswitchedin = false;
-	parentautoswitch = true;
+	childstate->switchedin = false;
+	parentstate->autoswitch = true;
 	
 }
 
 
 PowerSourceChargable::~PowerSourceChargable()
 {
+	PowerStateTable<CHARGABLE_SOLVER_STATE>::Get().Free(chargablestate);
 }
 
 
 double PowerSourceChargable::GetMaxCharge()
 {
-	return maxcharge;
+	return chargablestate->maxcharge;
 }
 
 double PowerSourceChargable::GetCharge()
 {
-	return charge;
+	return chargablestate->charge;
 }
 
 double PowerSourceChargable::GetChargingEfficiency()
 {
-	return efficiency;
+	return chargablestate->efficiency;
 }
 
 double PowerSourceChargable::GetMaxOutputCurrent(bool force)
 {
-	if (charge <= 0)
+	if (chargablestate->charge <= 0)
 	{
 		//if there's no charge, there's no current.
 		return 0;
 	}
-	else if (settocharging && !parentautoswitch)
+	else if (chargablestate->settocharging && !parentstate->autoswitch)
 	{
 		//the user does not allow this source to provide power at the moment
 		return 0;
@@ -72,10 +82,10 @@ double PowerSourceChargable::GetMaxOutputCurrent(bool force)
 void PowerSourceChargable::SetMaxCharge(double maxcharge)
 {
 	assert(maxcharge >= 0 && "Attempting to set a negative maximum charge!");
-	if (maxcharge != this->maxcharge)
+	if (maxcharge != chargablestate->maxcharge)
 	{
-		this->maxcharge = maxcharge;
-		lowchargelimit = this->maxcharge * 0.1;
+		chargablestate->maxcharge = maxcharge;
+		chargablestate->lowchargelimit = chargablestate->maxcharge * 0.1;
 		RegisterChildStateChange();
 	}
 }
@@ -83,43 +93,41 @@ void PowerSourceChargable::SetMaxCharge(double maxcharge)
 void PowerSourceChargable::SetCharge(double charge)
 {
 	assert(charge >= 0 && "Attempting to set a negative charge!");
-	if (charge != this->charge)
+	if (charge != chargablestate->charge)
 	{
-		double oldcharge = this->charge;
-		this->charge = charge;
+		double oldcharge = chargablestate->charge;
+		chargablestate->charge = charge;
 		RegisterChildStateChange();
-		if (chargeEmpty && oldcharge > 0.0 && this->charge <= 0.0) chargeEmpty(this);
-		else if (chargeLow && oldcharge >= lowchargelimit && this->charge < lowchargelimit) chargeLow(this);
-		
+		registerChargeChange(oldcharge);
 	}
 }
 
 void PowerSourceChargable::SetChargingEfficiency(double efficiency)
 {
 	assert(efficiency > 0 && efficiency < 1 && "Efficiency must be >0 <1");
-	if (efficiency != this->efficiency)
+	if (efficiency != chargablestate->efficiency)
 	{
-		this->efficiency = efficiency;
+		chargablestate->efficiency = efficiency;
 		RegisterChildStateChange();
 	}
 }
 
 void PowerSourceChargable::SetToCharging()
 {
-	if (!settocharging || parentautoswitch)
+	if (!chargablestate->settocharging || parentstate->autoswitch)
 	{
-		settocharging = true;
-		parentautoswitch = false;
+		chargablestate->settocharging = true;
+		parentstate->autoswitch = false;
 		SetParentSwitchedIn(false);
 	}
 }
 
 void PowerSourceChargable::SetToProviding()
 {
-	if (settocharging || parentautoswitch)
+	if (chargablestate->settocharging || parentstate->autoswitch)
 	{
-		settocharging = false;
-		parentautoswitch = false;
+		chargablestate->settocharging = false;
+		parentstate->autoswitch = false;
 		SetParentSwitchedIn(true);
 	}
 }
@@ -127,14 +135,14 @@ void PowerSourceChargable::SetToProviding()
 void PowerSourceChargable::SetParentSwitchedIn(bool switchedin)
 {
 	//if the source is to be switched in, it must not be set to charge, and have a charge above the threshold.
-	if (switchedin && !settocharging && charge > maxcharge * autoswitchthreshold)
+	if (switchedin && !chargablestate->settocharging && chargablestate->charge > chargablestate->maxcharge * chargablestate->autoswitchthreshold)
 	{
 		PowerParent::SetParentSwitchedIn(true);
 		PowerChild::SetChildSwitchedIn(false);
 		SetConsumerLoad(1);
 	}
 	//if it's to be switched out, and it's set to charging or on autoswitch, it must start to charge.
-	else if (!switchedin && (settocharging || parentautoswitch))
+	else if (!switchedin && (chargablestate->settocharging || parentstate->autoswitch))
 	{
 		PowerParent::SetParentSwitchedIn(false);
 		PowerChild::SetChildSwitchedIn(true);
@@ -181,14 +189,14 @@ void PowerSourceChargable::Evaluate(double deltatime)
 	if (IsChildSwitchedIn())
 	{
 		//The source is charging
-		if (charge < maxcharge)
+		if (chargablestate->charge < chargablestate->maxcharge)
 		{
-			double inputcharge_inWh = GetCurrentPowerConsumption() * (deltatime / MILIS_PER_HOUR) * efficiency;
-			charge += inputcharge_inWh;
-			if (charge >= maxcharge)
+			double inputcharge_inWh = GetCurrentPowerConsumption() * (deltatime / MILIS_PER_HOUR) * chargablestate->efficiency;
+			chargablestate->charge += inputcharge_inWh;
+			if (chargablestate->charge >= chargablestate->maxcharge)
 			{
 				//reached maximum charge, switch the charger out.
-				charge = maxcharge;
+				chargablestate->charge = chargablestate->maxcharge;
 				PowerChild::SetChildSwitchedIn(false);
 				RegisterChildStateChange();
 			}
@@ -197,23 +205,59 @@ void PowerSourceChargable::Evaluate(double deltatime)
 	else if (IsParentSwitchedIn())
 	{
 		//the source is providing power
-		if (charge > 0)
+		if (chargablestate->charge > 0)
 		{
-			double oldcharge = charge;
+			double oldcharge = chargablestate->charge;
 			double output = GetCurrentPowerOutput();
 			double factor = deltatime / MILIS_PER_HOUR;
 			double outputcharge_inWh = GetCurrentPowerOutput() * (deltatime / MILIS_PER_HOUR);
-			charge -= outputcharge_inWh;
-			if (charge <= 0)
+			chargablestate->charge -= outputcharge_inWh;
+			if (chargablestate->charge <= 0)
 			{
 				//we're neglecting possible overdraw at high timesteps. nobody will care that the equipment was running a few minutes longer than it should have.
-				charge = 0;
+				chargablestate->charge = 0;
 				SetParentSwitchedIn(false);
 				RegisterChildStateChange();
-				curroutputcurrent = 0;
-				if (chargeEmpty != NULL) chargeEmpty(this);
+				sourcestate->outputcurrent = 0;
 			}
-			else if (chargeLow != NULL && oldcharge >= lowchargelimit && charge < lowchargelimit) chargeLow(this);
+			registerChargeChange(oldcharge);
 		}
 	}
 }
+
+
+void PowerSourceChargable::fireChargeEvents(double oldcharge)
+{
+	if (parentsubscriptions == NULL)
+	{
+		return;
+	}
+	if (oldcharge > 0.0 && chargablestate->charge <= 0.0) parentsubscriptions->chargeempty.Invoke(this);
+	else if (oldcharge >= chargablestate->lowchargelimit && chargablestate->charge < chargablestate->lowchargelimit) parentsubscriptions->chargelow.Invoke(this);
+}
+
+void PowerSourceChargable::registerChargeChange(double oldcharge)
+{
+	PowerEventQueue *eventqueue = PowerParent::getEventQueue();
+	if (eventqueue != NULL)
+	{
+		eventqueue->Raise(PEVT_CHARGE, this, oldcharge);
+	}
+	else
+	{
+		fireChargeEvents(oldcharge);
+	}
+}
+
+
+unsigned int PowerSourceChargable::OnChargeLow(function<void(PowerSourceChargable*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->chargelow, lambda);
+}
+
+unsigned int PowerSourceChargable::OnChargeEmpty(function<void(PowerSourceChargable*)> lambda)
+{
+	PARENT_SUBSCRIPTIONS *subscriptions = getParentSubscriptions();
+	return subscriptions->Add(subscriptions->chargeempty, lambda);
+}
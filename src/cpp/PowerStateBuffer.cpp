@@ -0,0 +1,46 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerStateBuffer.h"
+
+
+PowerStateBuffer::PowerStateBuffer()
+	: pendingindex(2)
+{
+}
+
+
+PowerStateBuffer::~PowerStateBuffer()
+{
+}
+
+
+const POWER_STATE_FRAME *PowerStateBuffer::Acquire()
+{
+	if (pendingindex.load(memory_order_relaxed) & NEW_FRAME_FLAG)
+	{
+		//swap our frame for the one the simulation handed over last. acquire pairs with the release in publish().
+		unsigned int newindex = pendingindex.exchange(readindex, memory_order_acq_rel);
+		readindex = newindex & INDEX_MASK;
+	}
+	return &frames[readindex];
+}
+
+
+bool PowerStateBuffer::HasNewFrame()
+{
+	return (pendingindex.load(memory_order_relaxed) & NEW_FRAME_FLAG) != 0;
+}
+
+
+POWER_STATE_FRAME *PowerStateBuffer::getWriteFrame()
+{
+	return &frames[writeindex];
+}
+
+
+void PowerStateBuffer::publish()
+{
+	//if the reader didn't take the previous frame, we just get it back and overwrite it next time.
+	unsigned int oldindex = pendingindex.exchange(writeindex | NEW_FRAME_FLAG, memory_order_acq_rel);
+	writeindex = oldindex & INDEX_MASK;
+}
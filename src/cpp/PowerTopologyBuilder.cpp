@@ -0,0 +1,347 @@
+#include "stdincludes.h"
+#include "PowerTypes.h"
+#include "PowerChild.h"
+#include "PowerParent.h"
+#include "PowerSource.h"
+#include "PowerTopologyBuilder.h"
+
+
+PowerTopologyBuilder::PowerTopologyBuilder()
+	: resultsavailable(false)
+{
+}
+
+
+PowerTopologyBuilder::~PowerTopologyBuilder()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		stop = true;
+	}
+	jobavailable.notify_all();
+	if (worker.joinable())
+	{
+		worker.join();
+	}
+
+	for (auto i = jobs.begin(); i != jobs.end(); ++i)
+	{
+		delete (*i);
+	}
+	for (auto i = results.begin(); i != results.end(); ++i)
+	{
+		delete (*i);
+	}
+}
+
+
+void PowerTopologyBuilder::Submit(TOPOLOGY_SNAPSHOT *snapshot)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		//a snapshot of the same circuit that is still waiting would only produce an outdated result.
+		for (auto i = jobs.begin(); i != jobs.end(); )
+		{
+			if ((*i)->circuit == snapshot->circuit)
+			{
+				delete (*i);
+				i = jobs.erase(i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+		jobs.push_back(snapshot);
+
+		if (!worker.joinable())
+		{
+			worker = thread(&PowerTopologyBuilder::work, this);
+		}
+	}
+	jobavailable.notify_one();
+}
+
+
+void PowerTopologyBuilder::CollectResults(vector<TOPOLOGY_RESULT*> &OUT_results)
+{
+	if (!resultsavailable.load(memory_order_acquire))
+	{
+		return;
+	}
+
+	lock_guard<mutex> guard(lock);
+	OUT_results.insert(OUT_results.end(), results.begin(), results.end());
+	results.clear();
+	resultsavailable.store(false, memory_order_release);
+}
+
+
+void PowerTopologyBuilder::WaitUntilIdle()
+{
+	unique_lock<mutex> guard(lock);
+	idle.wait(guard, [this]() { return jobs.size() == 0 && !busy; });
+}
+
+
+void PowerTopologyBuilder::work()
+{
+	unique_lock<mutex> guard(lock);
+	while (true)
+	{
+		jobavailable.wait(guard, [this]() { return stop || jobs.size() > 0; });
+		if (stop)
+		{
+			return;
+		}
+
+		TOPOLOGY_SNAPSHOT *snapshot = jobs.front();
+		jobs.pop_front();
+		busy = true;
+
+		//the actual work is done without holding the lock, so the simulation thread can keep submitting and collecting.
+		guard.unlock();
+		TOPOLOGY_RESULT *result = Build(snapshot);
+		delete snapshot;
+		guard.lock();
+
+		results.push_back(result);
+		resultsavailable.store(true, memory_order_release);
+		busy = false;
+		if (jobs.size() == 0)
+		{
+			idle.notify_all();
+		}
+	}
+}
+
+
+TOPOLOGY_RESULT *PowerTopologyBuilder::Build(TOPOLOGY_SNAPSHOT *snapshot)
+{
+	TOPOLOGY_RESULT *result = new TOPOLOGY_RESULT;
+	result->circuit = snapshot->circuit;
+	result->topologystamp = snapshot->topologystamp;
+	result->sources = snapshot->sources;
+	result->buses = snapshot->buses;
+	unsigned int sourcecount = snapshot->sources.size();
+	unsigned int elementcount = sourcecount + snapshot->buses.size();
+	unsigned int edgecount = snapshot->parents.size();
+	result->maskwords = (elementcount + 63) / 64;
+	result->edgeoffsets.assign(snapshot->parentoffsets.begin(), snapshot->parentoffsets.end());
+	result->edgemasks.assign(edgecount, 0);
+	result->edgebases.assign(edgecount, -1);
+	result->edgeelements.assign(edgecount, 0);
+
+	if (snapshot->reduce)
+	{
+		reduce(snapshot, result);
+	}
+
+	unsigned int maskcount = 0;
+	for (unsigned int edge = 0; edge < edgecount; ++edge)
+	{
+		if (result->edgemasks[edge] >= 0)
+		{
+			result->edgemasks[edge] = maskcount;
+			maskcount++;
+		}
+	}
+	result->masks.assign(maskcount * result->maskwords, 0);
+
+	//instead of a set of processed parents, every bus remembers the search it was last visited in.
+	//Sources don't need to be tracked, they only have one child and can't be reached twice.
+	vector<unsigned int> visited(snapshot->buses.size(), 0);
+	unsigned int search = 0;
+	//queue entries are bus indices.
+	vector<unsigned int> queue;
+	queue.reserve(snapshot->buses.size());
+
+	for (unsigned int bus = 0; bus < snapshot->buses.size(); ++bus)
+	{
+		for (unsigned int edge = snapshot->parentoffsets[bus]; edge < snapshot->parentoffsets[bus + 1]; ++edge)
+		{
+			if (result->edgemasks[edge] < 0)
+			{
+				continue;
+			}
+			search++;
+			visited[bus] = search;
+			unsigned long long *mask = result->masks.data() + result->edgemasks[edge] * result->maskwords;
+
+			queue.clear();
+			unsigned int start = snapshot->parents[edge];
+			mask[start / 64] |= 1ull << (start % 64);
+			if (start >= sourcecount)
+			{
+				visited[start - sourcecount] = search;
+				queue.push_back(start - sourcecount);
+			}
+
+			for (unsigned int next = 0; next < queue.size(); ++next)
+			{
+				unsigned int currentbus = queue[next];
+				for (unsigned int i = snapshot->parentoffsets[currentbus]; i < snapshot->parentoffsets[currentbus + 1]; ++i)
+				{
+					unsigned int parent = snapshot->parents[i];
+					if (parent < sourcecount)
+					{
+						mask[parent / 64] |= 1ull << (parent % 64);
+					}
+					else if (visited[parent - sourcecount] != search)
+					{
+						visited[parent - sourcecount] = search;
+						mask[parent / 64] |= 1ull << (parent % 64);
+						queue.push_back(parent - sourcecount);
+					}
+				}
+			}
+		}
+	}
+	return result;
+}
+
+
+void PowerTopologyBuilder::reduce(TOPOLOGY_SNAPSHOT *snapshot, TOPOLOGY_RESULT *result)
+{
+	unsigned int sourcecount = snapshot->sources.size();
+	unsigned int edgecount = snapshot->parents.size();
+	unsigned int buscount = snapshot->buses.size();
+	const int NOT_DERIVED = -2;
+	vector<int> bases(edgecount, NOT_DERIVED);
+
+	//only edges across a bridge, i.e. a connection that would split the buses in two if removed, can be derived.
+	//Inside a loop, the other side of a chain leads back to the bus the edge goes to. Bridges are found with Tarjans algorithm.
+	vector<unsigned char> bridges(edgecount, 0);
+	vector<unsigned int> discovered(buscount, 0);
+	vector<unsigned int> low(buscount, 0);
+	unsigned int time = 0;
+	struct DFS_FRAME
+	{
+		unsigned int bus;
+		unsigned int from;						//!< The bus this one was discovered from, or buscount for the root.
+		unsigned int next;						//!< The next parent edge of bus to look at.
+	};
+	vector<DFS_FRAME> stack;
+	for (unsigned int root = 0; root < buscount; ++root)
+	{
+		if (discovered[root] != 0)
+		{
+			continue;
+		}
+		time++;
+		discovered[root] = low[root] = time;
+		stack.push_back({ root, buscount, snapshot->parentoffsets[root] });
+		while (stack.size() > 0)
+		{
+			DFS_FRAME &frame = stack.back();
+			if (frame.next < snapshot->parentoffsets[frame.bus + 1])
+			{
+				unsigned int parent = snapshot->parents[frame.next];
+				frame.next++;
+				if (parent < sourcecount || parent - sourcecount == frame.from)
+				{
+					continue;
+				}
+				unsigned int parentbus = parent - sourcecount;
+				if (discovered[parentbus] == 0)
+				{
+					time++;
+					discovered[parentbus] = low[parentbus] = time;
+					stack.push_back({ parentbus, frame.bus, snapshot->parentoffsets[parentbus] });
+				}
+				else
+				{
+					low[frame.bus] = min(low[frame.bus], discovered[parentbus]);
+				}
+			}
+			else
+			{
+				unsigned int bus = frame.bus;
+				unsigned int from = frame.from;
+				stack.pop_back();
+				if (from == buscount)
+				{
+					continue;
+				}
+				low[from] = min(low[from], low[bus]);
+				if (low[bus] > discovered[from])
+				{
+					//mark the edges in both directions.
+					for (unsigned int i = snapshot->parentoffsets[from]; i < snapshot->parentoffsets[from + 1]; ++i)
+					{
+						if (snapshot->parents[i] == sourcecount + bus) bridges[i] = 1;
+					}
+					for (unsigned int i = snapshot->parentoffsets[bus]; i < snapshot->parentoffsets[bus + 1]; ++i)
+					{
+						if (snapshot->parents[i] == sourcecount + from) bridges[i] = 1;
+					}
+				}
+			}
+		}
+	}
+
+	//find the edges that can be derived, and the edge each is derived from.
+	for (unsigned int bus = 0; bus < buscount; ++bus)
+	{
+		for (unsigned int edge = snapshot->parentoffsets[bus]; edge < snapshot->parentoffsets[bus + 1]; ++edge)
+		{
+			unsigned int parent = snapshot->parents[edge];
+			if (parent < sourcecount || !bridges[edge])
+			{
+				continue;
+			}
+			unsigned int parentbus = parent - sourcecount;
+			unsigned int first = snapshot->parentoffsets[parentbus];
+			unsigned int count = snapshot->parentoffsets[parentbus + 1] - first;
+			bool hassources = false;
+			for (unsigned int i = first; i < first + count; ++i)
+			{
+				hassources = hassources || snapshot->parents[i] < sourcecount;
+			}
+			if (hassources || count > 2)
+			{
+				continue;
+			}
+			if (count == 1)
+			{
+				//a leaf, its only parent is the bus the edge goes to.
+				bases[edge] = -1;
+			}
+			else
+			{
+				//a link in a chain, derived from the edge that feeds it from the other side.
+				bases[edge] = snapshot->parents[first] == sourcecount + bus ? first + 1 : first;
+			}
+			result->edgeelements[edge] = parent;
+		}
+	}
+
+	//order the derived edges so every base comes first. Following the bases always leads further away across bridges, so there are no loops.
+	vector<unsigned char> ordered(edgecount, 0);
+	vector<unsigned int> path;
+	for (unsigned int start = 0; start < edgecount; ++start)
+	{
+		path.clear();
+		int edge = start;
+		while (edge >= 0 && bases[edge] != NOT_DERIVED && !ordered[edge])
+		{
+			assert(find(path.begin(), path.end(), (unsigned int)edge) == path.end() && "Derived edges form a loop!");
+			path.push_back(edge);
+			edge = bases[edge];
+		}
+		for (auto i = path.rbegin(); i != path.rend(); ++i)
+		{
+			ordered[(*i)] = 1;
+			result->derivedorder.push_back((*i));
+		}
+	}
+
+	for (unsigned int edge = 0; edge < edgecount; ++edge)
+	{
+		if (bases[edge] != NOT_DERIVED)
+		{
+			result->edgemasks[edge] = -1;
+			result->edgebases[edge] = bases[edge];
+		}
+	}
+}
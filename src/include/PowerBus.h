@@ -3,10 +3,14 @@
 class PowerConsumer;
 class PowerCircuit;
 class PowerCircuitManager;
+struct BUS_SOLVER_STATE;
 
 class PowerBus : public PowerChild, public PowerParent
 {
 	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
+	friend class PowerReachabilityTable;
+	friend class PowerNodalSolver;
 public:
 	/**
 	 * \param voltage The voltage at which this bus is intended to operate.
@@ -47,6 +51,13 @@ public:
 	 */
 	void SetMaxCurrent(double amps);
 
+	/**
+	 * \brief Sets the resistance of the bus itself, e.g. of its cabling, in Ohm.
+	 * The connection between two buses has the sum of their resistances. Only considered if the nodal solver is enabled
+	 * in the PowerCircuitManager, the default solver treats all buses as ideal conductors.
+	 */
+	void SetResistance(double ohms);
+
 	/**
 	 * \brief Bus will attempt to reduce its current flow by shutting down consumers.
 	 * \param missing_current The amount of current the bus should reduce in amps
@@ -55,22 +66,12 @@ public:
 	double ReduceCurrentFlow(double missing_current);
 
 	/**
-	 * \brief Tells the bus to calculate the total current running through it.
+	 * \brief Tells the bus the total current running through it, as calculated by the PowerReachabilityTable of its circuit.
 	 * This is the last operation in circuit evaluation to be called. Should not ever be called
 	 * under any other circumstances.
-	 * \param deltatime Time passed since the last evaluation, in miliseconds.
-	 */
-	void CalculateTotalCurrentFlow(double deltatime);
-
-	/**
-	 * \brief Lets the bus delete all its feeding subcircuits and reconstruct them anew.
-	 * This is a relatively expensive operation, but is neccessary to perform when the structure
-	 * of a circuit changes.
-	 * \todo This could be optimised by introducing structural state observers, so only affected
-	 *	subcircuits get rebuilt. It would increase complexity quite a bit, but is a feasible option
-	 *	if circuit building turns out to take too long in the sim.
+	 * \param amps The current flowing through the bus, in Amperes.
 	 */
-	void RebuildFeedingSubcircuits();
+	void SetTotalCurrentFlow(double amps);
 
 	/**
 	 * \return The PowerCircuitManager this bus is controlled by.
@@ -102,59 +103,65 @@ public:
 	/**
 	* \brief register lambda that fires when the current throughput of this bus changes.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnCurrentThroughputChange(function<void(PowerBus*)> lambda) { currentThroughputChanged = lambda; };
+	virtual unsigned int OnCurrentThroughputChange(function<void(PowerBus*)> lambda);
 
 	/**
 	* \brief register lambda that fires when the maximum current of this bus is breached.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnMaxCurrentHigh(function<void(PowerBus*)> lambda) { maxCurrentHigh = lambda; };
+	virtual unsigned int OnMaxCurrentHigh(function<void(PowerBus*)> lambda);
 
 	/**
 	* \brief register lambda that fires when the load of the bus falls into save range again.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnMaxCurrentOk(function<void(PowerBus*)> lambda) { maxCurrentOk = lambda; };
+	virtual unsigned int OnMaxCurrentOk(function<void(PowerBus*)> lambda);
 
 	/**
 	 * \brief Buses cannot be actively switched, therefore it is impossible to register switch events for them!
 	 *\throws runtime_error
 	 */
-	virtual void OnChildSwitchIn(function<void(PowerChild*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
+	virtual unsigned int OnChildSwitchIn(function<void(PowerChild*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
 
 	/**
 	* \brief Buses cannot be actively switched, therefore it is impossible to register switch events for them!
 	*\throws runtime_error
 	*/
-	virtual void OnChildSwitchOut(function<void(PowerChild*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
+	virtual unsigned int OnChildSwitchOut(function<void(PowerChild*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
 
 	/**
 	 * \brief Buses cannot be actively switched, therefore it is impossible to register switch events for them!
  	 *\throws runtime_error
 	 */
-	virtual void OnParentSwitchIn(function<void(PowerParent*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
+	virtual unsigned int OnParentSwitchIn(function<void(PowerParent*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
 
 	/**
 	* \brief Buses cannot be actively switched, therefore it is impossible to register switch events for them!
 	*\throws runtime_error
 	*/
-	virtual void OnParentSwitchOut(function<void(PowerParent*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
+	virtual unsigned int OnParentSwitchOut(function<void(PowerParent*)> lambda) { throw logic_error("Bus cannot be switched, do not register event!"); };
 
 protected:
-
-	double maxcurrent = -1;
-	double equivalent_resistance = -1;
-	double throughcurrent = -1;
-
+	BUS_SOLVER_STATE *busstate = NULL;							//!< Per-frame state, allocated from the bus table.
 	PowerCircuitManager *circuitmanager = NULL;
-	vector<PowerSubCircuit*> feeding_subcircuits;				//!< The subcircuits feeding current to this bus.
-	
-	function<void(PowerBus*)> currentThroughputChanged = NULL;
-	function<void(PowerBus*)> maxCurrentHigh = NULL;
-	function<void(PowerBus*)> maxCurrentOk = NULL;
+	unsigned int reachabilityindex = 0;							//!< The index of this bus in the reachability table or nodal solver of its circuit.
+
+	/**
+	 * \brief Fires the current change, max current high and max current ok events according to the change from the old current.
+	 * \param oldcurrent The current flowing through the bus before the change.
+	 */
+	void fireCurrentEvents(double oldcurrent);
 
 private:
+	/**
+	 * \return The memory resource of the manager, or the default resource if the bus has no manager.
+	 */
+	static pmr::memory_resource *getMemoryResource(PowerCircuitManager *circuitmanager);
+
 	unsigned int locationid = 0;
 };
 
@@ -1,7 +1,13 @@
 #pragma once
+#include "PowerSmallVector.h"
+#include "PowerSpan.h"
 
 class PowerParent;
 class PowerCircuit;
+class PowerEventQueue;
+class PowerElementRegistry;
+struct CHILD_SUBSCRIPTIONS;
+struct CHILD_SOLVER_STATE;
 
 
 /**
@@ -10,6 +16,9 @@ class PowerCircuit;
 class PowerChild
 {
 	friend class PowerParent;
+	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
+	friend class PowerElementRegistry;
 public:
 	
 	/**
@@ -19,8 +28,9 @@ public:
 	 * \param location_id The identifier of the objects location. Unless both objects are global,
 	 *	relationships can only be formed with objects in the same location.
 	 * \param global Pass true if this child can form relationships with parents outside of its location.
+	 * \param resource The memory resource the adjacency of this child is allocated from.
 	 */
-	PowerChild(POWERCHILD_TYPE type, double minvoltage, double maxvoltage, bool switchable = true);
+	PowerChild(POWERCHILD_TYPE type, double minvoltage, double maxvoltage, bool switchable = true, pmr::memory_resource *resource = pmr::get_default_resource());
 	virtual ~PowerChild();
 
 	/**
@@ -52,6 +62,11 @@ public:
 	*/
 	virtual void GetParents(vector<PowerParent*> &OUT_parents);
 
+	/**
+	 * \return The parents of this child, without copying them. Invalidated by connecting or disconnecting the child.
+	 */
+	PowerSpan<PowerParent*> GetParents();
+
 	/**
 	 * \return The childs resistance in Ohm.
 	 * \note Implementations of this method should always return the resistance of the child alone, without considering possible attached children.
@@ -107,32 +122,63 @@ public:
 	/**
 	* \brief register lambda that fires when child is switched in.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveChildEventHandler().
 	*/
-	virtual void OnChildSwitchIn(function<void(PowerChild*)> lambda) { childSwitchIn = lambda; };
+	virtual unsigned int OnChildSwitchIn(function<void(PowerChild*)> lambda);
 
 	/**
 	* \brief register lambda that fires when child is switched out.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveChildEventHandler().
 	*/
-	virtual void OnChildSwitchOut(function<void(PowerChild*)> lambda) { childSwitchOut = lambda; };
+	virtual unsigned int OnChildSwitchOut(function<void(PowerChild*)> lambda);
+
+	/**
+	 * \brief Removes a handler registered with any of the events of the child side of this element.
+	 * \param id The id returned when the handler was registered.
+	 * \return True if the handler was found.
+	 */
+	bool RemoveChildEventHandler(unsigned int id);
 
-	
 protected:
 
-	vector<PowerParent*> parents;
-	bool childswitchedin = true;
-	VOLTAGE_INFO inputvoltage;
+	CHILD_SOLVER_STATE *childstate = NULL;				//!< Per-frame state, part of the state of the implementing kind. Set by the implementing class.
+	PowerSmallVector<PowerParent*, 2> parents;			//!< Inline for the common case of one or two parents.
+	VOLTAGE_INFO inputvoltagerange;						//!< Minimum and maximum input voltage. The current voltage is part of childstate.
 
 	/**
 	 * \brief Notifies all parents that the state of this child has changed.
 	 */
 	void registerStateChangeWithParents();
 
-	function<void(PowerChild*)> childSwitchIn = NULL;
-	function<void(PowerChild*)> childSwitchOut = NULL;
+	/**
+	 * \return The event queue of the manager this child is managed by, or NULL if it isn't connected to a circuit.
+	 */
+	PowerEventQueue *getEventQueue();
+
+	/**
+	 * \brief Fires the switch in or switch out event if the switch state differs from before.
+	 * \param wasswitchedin The switch state before the change.
+	 */
+	void fireChildSwitchEvent(bool wasswitchedin);
+
+	/**
+	 * \brief Raises the switch event through the event queue, or fires it directly if there is none.
+	 * \param wasswitchedin The switch state before the change.
+	 */
+	void raiseChildSwitchEvent(bool wasswitchedin);
+
+	/**
+	 * \return The event handlers of this child. Allocated on first call.
+	 */
+	CHILD_SUBSCRIPTIONS *getChildSubscriptions();
+
+	CHILD_SUBSCRIPTIONS *childsubscriptions = NULL;		//!< Registered event handlers, NULL until the first one is registered.
 
 private:
 	POWERCHILD_TYPE childtype;
 	bool childcanswitch = true;
+	PowerElementRegistry *registry = NULL;				//!< The registry this element is registered with, NULL if it isn't registered.
+	POWER_HANDLE handle = 0;							//!< The handle of this element in registry.
 };
 
@@ -3,7 +3,14 @@
 class PowerSource;
 class PowerBus;
 class PowerParent;
+class PowerCircuitManager;
 struct POWERSOURCE_STATS;
+struct TOPOLOGY_SNAPSHOT;
+struct TOPOLOGY_RESULT;
+class PowerReachabilityTable;
+class PowerNodalSolver;
+class PowerSolveCache;
+struct SOLVE_CACHE_ENTRY;
 
 
 
@@ -51,11 +58,51 @@ public:
 	 */
 	void RegisterCrossCircuitCurrentDemandChange(double amps);
 
+	/**
+	 * \brief Informs the circuit that elements in it were connected or disconnected without any element joining or leaving it,
+	 * e.g. by closing or opening a loop. The reachability of its buses will be rebuilt during the next evaluation.
+	 */
+	void RegisterStructureChange();
+
+	/**
+	 * \return The PowerCircuitManager this circuit belongs to.
+	 */
+	PowerCircuitManager *GetCircuitManager();
+
+	/**
+	 * \return The reachability of the feeding edges of all buses in this circuit.
+	 */
+	PowerReachabilityTable *GetReachabilityTable();
+
+	/**
+	 * \return The recent solves of this circuit. Only filled if solve memoization is enabled in the PowerCircuitManager.
+	 */
+	PowerSolveCache *GetSolveCache();
+
+	/**
+	 * \return How often the sources limiting their current had to be found from scratch, because they were not the same as in the previous solve.
+	 */
+	unsigned int GetColdSolveCount();
+
+	/**
+	 * \return The nodal solver of this circuit. Only up to date if the nodal solver is enabled in the PowerCircuitManager.
+	 */
+	PowerNodalSolver *GetNodalSolver();
+
 protected:
 	double equivalent_resistance = -1;
 	double total_circuit_current = 0;
 	bool structurechanged = false;					//shows true if the circuit structure has changed since the last evaluation.
 	double circuit_current_demand_change = 0;			//shows change in current demand over an entire systems evaluation, AFTER this circuit was evaluated.
+	unsigned long long evaluatedpass = 0;			//!< The pass of the manager this circuit was last evaluated in.
+	unsigned int topologystamp = 0;					//!< Identifies the last structure submitted for an asynchronous rebuild. Results with a different stamp are outdated.
+	PowerCircuitManager *manager = NULL;			//!< The manager this circuit belongs to.
+	PowerReachabilityTable *reachability = NULL;	//!< Which elements feed which bus. Allocated from the memory resource of the circuit.
+	pmr::vector<PowerSource*> limitedsources;		//!< The sources that limited their current in the last solve, sorted by address. Next solve starts from here.
+	unsigned int coldsolves = 0;					//!< Number of solves in which the limited sources changed.
+	PowerSolveCache *solvecache = NULL;				//!< Recent solves, if the manager has memoization enabled. Allocated from the memory resource of the circuit.
+	bool solvechangedstate = false;					//!< Set during distributeCurrentDraw() if sources were switched or consumers shut down. Such solves can't be reused.
+	PowerNodalSolver *nodalsolver = NULL;			//!< Used instead of the reachability table if the manager has the nodal solver enabled. Allocated from the memory resource of the circuit.
 
 	/**
 	* \brief Calculates the entire equivalent resistance of this circuit.
@@ -74,24 +121,34 @@ protected:
 	/**
 	* \return The sum of equivalent internal resistances of the passed power sources
 	*/
-	double getSumOfEquivalentResistances(vector<POWERSOURCE_STATS*> &involved_sources);
+	double getSumOfEquivalentResistances(pmr::vector<POWERSOURCE_STATS*> &involved_sources);
 
 	/**
 	* \brief Calculates how much is drawn from each powersource and limits them to prevent voltage drop if too much is drawn.
 	* \note RECURSIVE!
-	* \param non_limited_sources A vector with stats of power sources that have not yet been limited. Pass all involved sources from outside!
+	* \param sources A vector with stats of power sources that have not yet been limited. Pass all involved sources from outside!
 	* \param required_current The total current that needs to be provided by the sources in non_limited_sources.
 	* \param force If true, will switch in sources that are set to autoswitch.
 	*/
-	void calculateCurrentDraw(vector<POWERSOURCE_STATS*> non_limited_sources, double required_current, bool force = false);
+	void calculateCurrentDraw(const pmr::vector<POWERSOURCE_STATS*> &sources, double required_current, bool force = false);
+
+	/**
+	 * \brief Calculates how much is drawn from each powersource, assuming the same sources are limited as in the last solve.
+	 * Loads rarely change enough between frames to limit or release a source, so this usually gets it right in a single pass.
+	 * \param sources The stats of all involved sources.
+	 * \param required_current The total current that needs to be provided by the sources.
+	 * \return False if the assumption turned out wrong, in which case the stats are left untouched and calculateCurrentDraw() has to find the limited sources.
+	 */
+	bool calculateCurrentDrawFromLastLimits(const pmr::vector<POWERSOURCE_STATS*> &sources, double required_current);
 
 	/**
 	* \brief switches in powersources on standby until are are switched in or there is enough current available.
+	* \param IN_OUT_stats Storage for the stats of the newly switched in powersources. Must have capacity for all of them.
 	* \param IN_OUT_involved_sources The newly switched in powersources are appended to this list.
 	* \param missing_current The amount of current the circuit still needs, in amps.
 	* \return The amount of current still missing after the switch in. If it's 0, everything's ok.
 	*/
-	double switchInPowerSourcesOnStandby(vector<POWERSOURCE_STATS*> &IN_OUT_involved_sources, double missing_current);
+	double switchInPowerSourcesOnStandby(pmr::vector<POWERSOURCE_STATS> &IN_OUT_stats, pmr::vector<POWERSOURCE_STATS*> &IN_OUT_involved_sources, double missing_current);
 
 	/**
 	* \brief Starts switching of consumers until there is enough current available.
@@ -108,8 +165,40 @@ protected:
 	void pushCurrentThroughCircuit();
 
 	/**
-	 * \brief Tells all buses to reconbuild their feeding subcircuits.
+	 * \brief Assembles the inputs of the solve in the key of the solve cache. Must be called after the buses were evaluated.
+	 */
+	void buildSolveKey();
+
+	/**
+	 * \brief Stores the solve that was just completed in the solve cache, under the key assembled before.
+	 */
+	void storeSolve();
+
+	/**
+	 * \brief Sets the circuit to the state of an earlier solve.
+	 */
+	void applySolve(SOLVE_CACHE_ENTRY *solve);
+
+	/**
+	 * \brief Rebuilds the reachability table of this circuit on the calling thread.
+	 */
+	void rebuildReachability();
+
+	/**
+	 * \brief Analyzes the structure of this circuit for the nodal solver.
+	 */
+	void rebuildNodalSolver();
+
+	/**
+	 * \return A newly allocated snapshot of the adjacency of all buses in this circuit. The caller takes ownership.
+	 * \see PowerTopologyBuilder
+	 */
+	TOPOLOGY_SNAPSHOT *createTopologySnapshot();
+
+	/**
+	 * \brief Swaps the reachability table of this circuit for the one built by a PowerTopologyBuilder.
+	 * \param result A result that was built from the current structure of this circuit.
 	 */
-	void rebuildAllSubCircuits();
+	void applyTopology(TOPOLOGY_RESULT *result);
 };
 
@@ -1,4 +1,18 @@
 #pragma once
+#include "PowerSpan.h"
+
+class PowerBus;
+class PowerSource;
+class PowerConsumer;
+class PowerSourceChargable;
+class PowerConverter;
+class PowerTopologyBuilder;
+class PowerStateBuffer;
+class PowerCommandQueue;
+class PowerEventQueue;
+class PowerEventStream;
+class PowerElementRegistry;
+template<class T> class PowerElementPool;
 
 /**
  * \brief Class to manage the existing powercircuits of an object in which circuits are allowed to interact.
@@ -6,8 +20,15 @@
  */
 class PowerCircuitManager
 {
+	friend class PowerCircuit;
 public:
-	PowerCircuitManager();
+	/**
+	 * \param resource The memory resource all circuits, reachability tables, elements created through the factories and internal containers of this manager
+	 *	are allocated from. Must outlive the manager and everything created through it. The default is the global heap.
+	 * \note Buses take the resource of their manager. Elements created with new take the resource passed to their constructor.
+	 *	When rebuilding topologies asynchronously, the worker thread never allocates from the resource.
+	 */
+	PowerCircuitManager(pmr::memory_resource *resource = pmr::get_default_resource());
 	~PowerCircuitManager();
 
 	/**
@@ -55,6 +76,11 @@ public:
 	 */
 	void GetPowerCircuits(vector<PowerCircuit*> &OUT_circuits);
 
+	/**
+	 * \return The circuits in this manager, without copying them. Invalidated whenever circuits are created, merged or split.
+	 */
+	PowerSpan<PowerCircuit*> GetPowerCircuits();
+
 	/**
 	 * \brief Registers a change in a circuit that was already calculated during this evaluation.
 	 * Only used internally, has no effect when not called during the evaluation loop.
@@ -62,13 +88,309 @@ public:
 	 */
 	void RegisterAlreadyEvaluatedCircuitChange();
 
+	/**
+	 * \return The number of passes over all circuits the last Evaluate() needed until no circuit changed anymore.
+	 * Circuits are solved before the circuits feeding them through converters, so this is 1 unless converters form a cycle
+	 * or an input circuit can't supply what its converters demand.
+	 */
+	unsigned int GetLastEvaluationPassCount();
+
 	/**
 	 * \return The number of circuits in the manager.
 	 */
 	unsigned int GetSize();
 
+	/**
+	 * \brief Enables or disables rebuilding the reachability tables of circuits on a worker thread after structural changes.
+	 * When enabled, the adjacency of a changed circuit is snapshotted during its next evaluation and handed to a worker thread.
+	 * Evaluation continues with the old tables until the new ones are done, which are then swapped in at the beginning of the next Evaluate().
+	 * \param enabled Pass true to rebuild asynchronously, false to rebuild during evaluation (default).
+	 * \note While a rebuild is pending, the through-currents of the affected buses reflect the old structure. Newly created circuits report no current until their first rebuild is swapped in.
+	 */
+	void SetAsyncTopologyRebuild(bool enabled);
+
+	/**
+	 * \return True if reachability tables are rebuilt on a worker thread.
+	 */
+	bool IsAsyncTopologyRebuildEnabled();
+
+	/**
+	 * \brief Blocks until all pending asynchronous rebuilds are done and swaps them in.
+	 * Use after loading or assembling a structure, when the results are needed right away.
+	 * \note Structural changes that were not yet evaluated have not been submitted, and will not be waited for!
+	 */
+	void FinishTopologyRebuilds();
+
+	/**
+	 * \return The builder used for asynchronous rebuilds, or NULL if they are disabled.
+	 */
+	PowerTopologyBuilder *GetTopologyBuilder();
+
+	/**
+	 * \brief Enables or disables reducing chains and leaves of buses when building reachability tables.
+	 * Edges coming out of such buses derive their surplus from their neighbour instead of storing a mask of their own,
+	 * which makes the tables of long feeders and radial networks a lot smaller. The through-currents are the same either way.
+	 * \param enabled Pass true to reduce the topology, false to store a mask for every edge (default).
+	 * \note Takes effect for every circuit during its next evaluation.
+	 */
+	void SetTopologyReduction(bool enabled);
+
+	/**
+	 * \return True if reachability tables are built from a reduced topology.
+	 */
+	bool IsTopologyReductionEnabled();
+
+	/**
+	 * \brief Enables or disables solving the current through buses by nodal analysis instead of reachability tables.
+	 * The nodal solver takes the resistance of buses into account (see PowerBus::SetResistance()), and allows buses in the same circuit
+	 * to be connected to each other, forming loops. Current then splits between the paths of a loop according to their resistance.
+	 * How much current every source provides is still decided the same way, the solver only distributes it through the buses.
+	 * \param enabled Pass true to use the nodal solver, false to use reachability tables (default).
+	 * \note Takes effect for every circuit during its next evaluation. Loops formed while the nodal solver is enabled remain when it is disabled again,
+	 *	and reachability tables count the current of a loop as reaching every bus in it.
+	 */
+	void SetNodalSolver(bool enabled);
+
+	/**
+	 * \return True if the current through buses is solved by nodal analysis.
+	 */
+	bool IsNodalSolverEnabled();
+
+	/**
+	 * \brief Enables or disables reusing recent solves of a circuit when it returns to the same state.
+	 * Every circuit remembers its last few solves together with their inputs: the resistance of its buses and their consumers,
+	 * and the availability and capacity of its sources. Pulsed loads that alternate between a few states then only need to be solved once per state.
+	 * \param enabled Pass true to memoize solves, false to always solve (default).
+	 * \note Solves that switch sources in or out, or shut down consumers, are never reused.
+	 */
+	void SetSolveMemoization(bool enabled);
+
+	/**
+	 * \return True if circuits reuse recent solves.
+	 */
+	bool IsSolveMemoizationEnabled();
+
+	/**
+	 * \brief Creates a buffer through which another thread can read the states of all elements without blocking the simulation.
+	 * As long as at least one buffer exists, the manager publishes the state of all elements at the end of every Evaluate().
+	 * \return A new buffer, owned by this manager. Every reading thread needs its own buffer.
+	 * \note Call from the simulation thread, and not while a reader might be using an existing buffer's frame.
+	 */
+	PowerStateBuffer *CreateStateBuffer();
+
+	/**
+	 * \brief Deletes a buffer created with CreateStateBuffer().
+	 * \note The reading thread must not access the buffer or any frame acquired from it anymore!
+	 */
+	void DeleteStateBuffer(PowerStateBuffer *buffer);
+
+	/**
+	 * \return The queue through which other threads can post state changes to elements in this manager.
+	 * Posted changes are applied at the beginning of the next Evaluate().
+	 */
+	PowerCommandQueue *GetCommandQueue();
+
+	/**
+	 * \return The queue that collects the events of elements in this manager during evaluation.
+	 */
+	PowerEventQueue *GetEventQueue();
+
+	/**
+	 * \brief Enables or disables deferring events that happen during evaluation.
+	 * When enabled, events are recorded while evaluating and fired once for their net change after evaluation is complete.
+	 * \param enabled Pass true to defer events (default), false to fire them in the middle of evaluation.
+	 */
+	void SetDeferredEvents(bool enabled);
+
+	/**
+	 * \return True if events that happen during evaluation are deferred until it is complete.
+	 */
+	bool IsDeferringEvents();
+
+	/**
+	 * \brief Starts writing all events of elements in this manager to a stream that can be read from another thread.
+	 * \param capacity The number of events the stream can hold before it overflows. Rounded up to a power of two.
+	 * \return The stream. Owned by this manager. If a stream already exists, it is returned unchanged.
+	 */
+	PowerEventStream *EnableEventStream(unsigned int capacity = 4096);
+
+	/**
+	 * \brief Stops writing events to the stream and deletes it.
+	 * \note The reading thread must not access the stream anymore!
+	 */
+	void DisableEventStream();
+
+	/**
+	 * \return The event stream, or NULL if it is not enabled.
+	 */
+	PowerEventStream *GetEventStream();
+
+	/**
+	 * \return The registry that hands out handles for the elements of this manager.
+	 */
+	PowerElementRegistry *GetRegistry();
+
+	/**
+	 * \return The memory resource this manager allocates from.
+	 */
+	pmr::memory_resource *GetMemoryResource();
+
+	/**
+	 * \brief Creates a bus in the pools of this manager. See PowerBus::PowerBus() for the parameters.
+	 * \return The new bus, owned by this manager. Destroy with DeleteBus() or by deleting the manager, never with delete!
+	 */
+	PowerBus *CreateBus(double voltage, double maxamps, unsigned int location_id);
+
+	/**
+	 * \brief Creates a source in the pools of this manager. See PowerSource::PowerSource() for the parameters.
+	 * \return The new source, owned by this manager. Destroy with DeleteSource() or by deleting the manager, never with delete!
+	 */
+	PowerSource *CreateSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global = false);
+
+	/**
+	 * \brief Creates a consumer in the pools of this manager. See PowerConsumer::PowerConsumer() for the parameters.
+	 * \return The new consumer, owned by this manager. Destroy with DeleteConsumer() or by deleting the manager, never with delete!
+	 */
+	PowerConsumer *CreateConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower = -1, double minimumload = 0.01, bool global = false);
+
+	/**
+	 * \brief Creates a rechargable source in the pools of this manager. See PowerSourceChargable::PowerSourceChargable() for the parameters.
+	 * \return The new source, owned by this manager. Destroy with DeleteChargableSource() or by deleting the manager, never with delete!
+	 */
+	PowerSourceChargable *CreateChargableSource(double minvoltage, double maxvoltage, double maxdischarge, double maxchargingpower, double charge,
+		double chargingefficiency, double internalresistance, unsigned int location_id, double minimumchargingload, bool global = false);
+
+	/**
+	 * \brief Creates a converter in the pools of this manager. See PowerConverter::PowerConverter() for the parameters.
+	 * \return The new converter, owned by this manager. Destroy with DeleteConverter() or by deleting the manager, never with delete!
+	 */
+	PowerConverter *CreateConverter(double minvoltage, double maxvoltage, double maxpower, double conversionefficiency, double internalresistance, unsigned int location_id, bool global = false);
+
+	/**
+	 * \brief Destroys a bus created with CreateBus().
+	 * \note Like deleting any element, this does not disconnect it. Disconnect it first if the rest of the structure lives on.
+	 */
+	void DeleteBus(PowerBus *bus);
+
+	/**
+	 * \brief Destroys a source created with CreateSource().
+	 */
+	void DeleteSource(PowerSource *source);
+
+	/**
+	 * \brief Destroys a consumer created with CreateConsumer().
+	 */
+	void DeleteConsumer(PowerConsumer *consumer);
+
+	/**
+	 * \brief Destroys a rechargable source created with CreateChargableSource().
+	 */
+	void DeleteChargableSource(PowerSourceChargable *source);
+
+	/**
+	 * \brief Destroys a converter created with CreateConverter().
+	 */
+	void DeleteConverter(PowerConverter *converter);
+
+	/**
+	 * \return The number of elements created with the factories of this manager that still exist.
+	 */
+	unsigned int GetPooledElementCount();
+
+	/**
+	 * \brief Bulk queries. Each copies one or more quantities of a list of elements into arrays owned by the caller,
+	 * reading the solver state directly instead of going through a getter per element and quantity.
+	 * The handle list doubles as the filter: get the handles of all elements of a kind with PowerElementRegistry::GetHandles(),
+	 * or pass any subset of them. Entries for invalid handles or elements of the wrong kind are set to 0 or false.
+	 * All output arrays must hold at least count entries. Optional outputs may be NULL.
+	 * \note Like the getters, only consistent between evaluations. Use a PowerStateBuffer to read from another thread.
+	 */
+	void QueryBusCurrents(const POWER_HANDLE *handles, unsigned int count, double *OUT_currents, double *OUT_maxcurrents = NULL);
+
+	/**
+	 * \brief Copies the state of consumers into caller owned arrays. See QueryBusCurrents() for details.
+	 */
+	void QueryConsumerStates(const POWER_HANDLE *handles, unsigned int count, double *OUT_loads, double *OUT_inputcurrents = NULL, bool *OUT_running = NULL, bool *OUT_switchedin = NULL);
+
+	/**
+	 * \brief Copies the state of sources into caller owned arrays. See QueryBusCurrents() for details.
+	 */
+	void QuerySourceStates(const POWER_HANDLE *handles, unsigned int count, double *OUT_outputcurrents, bool *OUT_switchedin = NULL);
+
+	/**
+	 * \brief Copies the charge of chargable sources into caller owned arrays, in Wh. See QueryBusCurrents() for details.
+	 */
+	void QueryCharges(const POWER_HANDLE *handles, unsigned int count, double *OUT_charges, double *OUT_maxcharges = NULL);
+
+	/**
+	 * \brief Sets the loads of many consumers at once. Same as calling PowerConsumer::SetConsumerLoad() for each, except that
+	 * every bus that feeds one of the consumers registers the change only once, after all loads are set.
+	 * \param handles The consumers to change. Handles that are invalid or not consumers are skipped.
+	 * \param loads The new load for each consumer, at the same index.
+	 * \return The number of consumers whose load was below their minimum load and was set to 0 instead.
+	 * \note Events are raised as the loads are set, so handlers that fire directly see the new load before the buses are marked.
+	 */
+	unsigned int SetConsumerLoads(PowerSpan<POWER_HANDLE> handles, PowerSpan<double> loads);
+
+	/**
+	 * \brief Switches many children in or out at once. Same as calling PowerChild::SetChildSwitchedIn() for each,
+	 * except that every parent registers the change only once. See SetConsumerLoads() for details.
+	 * \param handles The children to switch. Handles that are invalid or have no child side are skipped.
+	 * \param switchedin The new switch state for each child, at the same index.
+	 */
+	void SetChildrenSwitchedIn(PowerSpan<POWER_HANDLE> handles, PowerSpan<bool> switchedin);
+
 private:
-	vector<PowerCircuit*> circuits;				//!< Stores all PowerCircuits in this manager.
+	/**
+	 * \brief Registers a child state change once with each parent in the list. Used by the batch setters.
+	 * \param parents The parents of all children that changed. May contain duplicates.
+	 */
+	void registerChildStateChanges(pmr::vector<PowerParent*> &parents);
+
+	/**
+	 * \brief Sorts the circuits into evaluationorder, so demand flows from the output circuits of converters to their input circuits in a single pass.
+	 * Circuits that feed each other in a cycle keep their relative order at the end. Also collects the converters between circuits into evaluationconverters.
+	 */
+	void orderCircuitsByDemand();
+
+	pmr::memory_resource *memoryresource = NULL;	//!< Everything the manager allocates comes from here.
+	pmr::vector<PowerCircuit*> circuits;		//!< Stores all PowerCircuits in this manager.
 	bool reevaluate = false;					//!< Switches to true during evaluation if RegisterAlreadyEvaluatedCircuitChange() is called.
+	pmr::vector<PowerCircuit*> evaluationorder;	//!< The circuits in the order they are evaluated in: every circuit before the circuits it draws power from through converters.
+	pmr::vector<PowerConverter*> evaluationconverters;	//!< The converters connecting two different circuits.
+	unsigned long long evaluationpass = 0;		//!< Increases with every pass over all circuits.
+	unsigned int lastpasscount = 0;				//!< The number of passes the last Evaluate() needed.
+	PowerTopologyBuilder *topologybuilder = NULL;	//!< Rebuilds reachability tables on a worker thread. NULL if asynchronous rebuilds are disabled.
+	unsigned int lasttopologystamp = 0;			//!< The last topology stamp handed out to a circuit.
+	bool topologyreduction = false;				//!< Whether reachability tables are built from a reduced topology.
+	bool nodalsolver = false;					//!< Whether the current through buses is solved by nodal analysis.
+	bool solvememoization = false;				//!< Whether circuits reuse recent solves.
+	pmr::vector<PowerStateBuffer*> statebuffers;	//!< Buffers the element states are published to after every evaluation.
+	unsigned long long evaluationcount = 0;		//!< Number of completed calls to Evaluate().
+	PowerCommandQueue *commandqueue = NULL;		//!< Mutations posted from other threads, applied at the start of every evaluation.
+	PowerEventQueue *eventqueue = NULL;			//!< Collects events during evaluation.
+	bool deferevents = true;					//!< Whether events during evaluation are deferred.
+	PowerEventStream *eventstream = NULL;		//!< Publishes events to another thread. NULL if not enabled.
+	PowerElementRegistry *registry = NULL;		//!< Handles of all elements in this manager.
+	PowerElementPool<PowerBus> *buspool = NULL;	//!< Elements created through the factories, one pool per type.
+	PowerElementPool<PowerSource> *sourcepool = NULL;
+	PowerElementPool<PowerConsumer> *consumerpool = NULL;
+	PowerElementPool<PowerSourceChargable> *chargablepool = NULL;
+	PowerElementPool<PowerConverter> *converterpool = NULL;
+
+	/**
+	 * \return A new, unique topology stamp.
+	 */
+	unsigned int createTopologyStamp();
+
+	/**
+	 * \brief Swaps in all reachability tables the builder finished, unless they have been outdated in the meantime.
+	 */
+	void applyFinishedTopologies();
+
+	/**
+	 * \brief Writes the current state of all elements to every state buffer and hands it to the readers.
+	 */
+	void publishState();
 };
 
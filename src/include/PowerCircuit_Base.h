@@ -1,4 +1,5 @@
 #pragma once
+#include "PowerSpan.h"
 
 class PowerSource;
 class PowerBus;
@@ -7,9 +8,21 @@ class PowerParent;
 class PowerCircuit_Base
 {
 public:
-	PowerCircuit_Base(double voltage);
+	/**
+	 * \param voltage The voltage of the circuit.
+	 * \param resource The memory resource the member lists are allocated from.
+	 */
+	PowerCircuit_Base(double voltage, pmr::memory_resource *resource);
 	virtual ~PowerCircuit_Base();
 
+	/**
+	 * \brief Allocates a circuit from a memory resource, usually that of its PowerCircuitManager.
+	 * The resource is remembered in front of the circuit, so circuits can still be destroyed with a plain delete.
+	 */
+	static void *operator new(size_t size, pmr::memory_resource *resource);
+	static void operator delete(void *circuit, pmr::memory_resource *resource);
+	static void operator delete(void *circuit);
+
 	/**
 	* \brief Adds a generic powerparent to the circuit.
 	* Convenience function. Evaluates what type the parent is, and calls the appropriate method.
@@ -56,12 +69,22 @@ public:
 	*/
 	virtual void GetPowerSources(vector<PowerSource*> &OUT_sources);
 
+	/**
+	 * \return The power sources in this circuit, without copying them. Invalidated when a source is added or removed.
+	 */
+	PowerSpan<PowerSource*> GetPowerSources();
+
 	/**
 	* \brief Sets a reference to the list of buses in this circuit.
 	* \param OUT_buses Initialised but empty reference.
 	*/
 	virtual void GetPowerBuses(vector<PowerBus*> &OUT_buses);
 
+	/**
+	 * \return The buses in this circuit, without copying them. Invalidated when a bus is added or removed.
+	 */
+	PowerSpan<PowerBus*> GetPowerBuses();
+
 	/**
 	 * \return The voltage of this circuit.
 	 */
@@ -85,10 +108,19 @@ public:
 
 
 protected:
-	vector<PowerSource*> powersources;
-	vector<PowerBus*> powerbuses;
+	pmr::vector<PowerSource*> powersources;
+	pmr::vector<PowerBus*> powerbuses;
 	double voltage = -1;				//!< A circuit is always of the same voltage (parallel circuit).
 	bool statechange = true;
 
+private:
+	/**
+	 * \brief Stored in front of every circuit, padded so the circuit itself stays aligned.
+	 */
+	struct alignas(alignof(max_align_t)) ALLOCATION_HEADER
+	{
+		pmr::memory_resource *resource;
+		size_t size;							//!< Size of the allocation, including the header.
+	};
 };
 
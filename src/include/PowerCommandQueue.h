@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+
+class PowerChild;
+class PowerParent;
+class PowerConsumer;
+class PowerSource;
+class PowerSourceChargable;
+class PowerBus;
+
+enum POWER_COMMAND_TYPE
+{
+	PCMD_CONSUMER_LOAD,
+	PCMD_CONSUMER_RUNNING,
+	PCMD_MAX_POWER_CONSUMPTION,
+	PCMD_CHILD_SWITCHED_IN,
+	PCMD_PARENT_SWITCHED_IN,
+	PCMD_AUTOSWITCH,
+	PCMD_CHARGING_MODE,
+	PCMD_MAX_POWER_OUTPUT,
+	PCMD_BUS_MAX_CURRENT
+};
+
+/**
+ * \brief A single state mutation, queued to be applied on the simulation thread.
+ */
+struct POWER_COMMAND
+{
+	POWER_COMMAND_TYPE type = PCMD_CONSUMER_LOAD;
+	void *target = NULL;							//!< The element to mutate, as the type the command's setter is declared in (e.g. PowerChild for PCMD_CHILD_SWITCHED_IN).
+	double value = 0;								//!< Load, current or power, depending on the type.
+	bool flag = false;								//!< Switch state or mode, depending on the type.
+	atomic<POWER_COMMAND*> next;					//!< Link to the next command in the queue.
+
+	POWER_COMMAND() : next(NULL) {}
+};
+
+
+/**
+ * \brief Queue through which any thread can post state changes to elements, to be applied on the simulation thread.
+ * Posting never blocks. The PowerCircuitManager owning the queue applies all posted commands at the beginning of Evaluate().
+ * If an element receives more than one command of the same type before they are applied, only the last one takes effect.
+ * \note Elements must not be deleted while commands targeting them are still queued!
+ */
+class PowerCommandQueue
+{
+	friend class PowerCircuitManager;
+public:
+
+	/**
+	 * \brief Queues PowerConsumer::SetConsumerLoad().
+	 */
+	void PostConsumerLoad(PowerConsumer *consumer, double load);
+
+	/**
+	 * \brief Queues PowerConsumer::SetRunning().
+	 */
+	void PostConsumerRunning(PowerConsumer *consumer, bool running);
+
+	/**
+	 * \brief Queues PowerConsumer::SetMaxPowerConsumption().
+	 */
+	void PostMaxPowerConsumption(PowerConsumer *consumer, double watts);
+
+	/**
+	 * \brief Queues PowerChild::SetChildSwitchedIn().
+	 */
+	void PostChildSwitchedIn(PowerChild *child, bool switchedin);
+
+	/**
+	 * \brief Queues PowerParent::SetParentSwitchedIn().
+	 */
+	void PostParentSwitchedIn(PowerParent *parent, bool switchedin);
+
+	/**
+	 * \brief Queues PowerParent::SetAutoswitchEnabled().
+	 */
+	void PostAutoswitchEnabled(PowerParent *parent, bool enabled);
+
+	/**
+	 * \brief Queues PowerSourceChargable::SetToCharging() or PowerSourceChargable::SetToProviding().
+	 * \param charging Pass true to set the source to charging, false to set it to providing.
+	 * \note Both calls override each other, so they are coalesced as one command.
+	 */
+	void PostChargingMode(PowerSourceChargable *chargable, bool charging);
+
+	/**
+	 * \brief Queues PowerSource::SetMaxPowerOutput().
+	 */
+	void PostMaxPowerOutput(PowerSource *source, double watts);
+
+	/**
+	 * \brief Queues PowerBus::SetMaxCurrent().
+	 */
+	void PostBusMaxCurrent(PowerBus *bus, double amps);
+
+private:
+	/**
+	 * \param resource The memory resource used while applying commands. Commands themselves are posted from other threads and live on the heap.
+	 */
+	PowerCommandQueue(pmr::memory_resource *resource);
+	~PowerCommandQueue();
+
+	/**
+	 * \brief Links a command into the queue. Safe to call from any number of threads at once.
+	 */
+	void post(POWER_COMMAND *command);
+
+	/**
+	 * \brief Applies all commands that were completely posted so far, and deletes them.
+	 * \note Only call from the simulation thread!
+	 */
+	void apply();
+
+	POWER_COMMAND stub;								//!< Dummy node, so the queue is never empty and producers never have to touch tail.
+	atomic<POWER_COMMAND*> head;					//!< The most recently posted command. Producers swap themselves in here.
+	POWER_COMMAND *tail;							//!< The oldest command not yet taken. Only accessed by the simulation thread.
+	pmr::vector<POWER_COMMAND*> pending;				//!< Commands taken from the queue during apply(). Kept to avoid reallocation.
+};
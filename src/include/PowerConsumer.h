@@ -1,9 +1,12 @@
 #pragma once
 
 class PowerParent;
+struct CONSUMER_SOLVER_STATE;
 
 class PowerConsumer : public PowerChild
 {
+	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
 public:
 	/**
 	 * \param minvoltage Lower bound of the input voltage of this consumer.
@@ -14,8 +17,9 @@ public:
 	 * \param standbypower How much the consumer consumes at standby (running, but zero load). Default is 0.1% of max power.
 	 * \param minimumload The minimum load at which the consumer can operate (NOT Stanby power!). 
 	 * \param global If true, this consumer can form connections to other global objects regardless of their location.
+	 * \param resource The memory resource the adjacency of this consumer is allocated from. Use PowerCircuitManager::CreateConsumer() to allocate from the resource of a manager.
 	 */
-	PowerConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower = -1, double minimumload = 0.01, bool global = false);
+	PowerConsumer(double minvoltage, double maxvoltage, double maxpower, unsigned int location_id, double standbypower = -1, double minimumload = 0.01, bool global = false, pmr::memory_resource *resource = pmr::get_default_resource());
 
 	virtual ~PowerConsumer();
 
@@ -98,35 +102,55 @@ public:
 	/**
 	 * \brief register lambda that fires when the load of the consumer changes.
 	 * \param lambda Lambda function that receives this as an argument.
+	 * \return Id of the handler, to remove it with RemoveChildEventHandler().
 	 */
-	virtual void OnConsumerLoadChange(function<void(PowerConsumer*)> lambda) { consumerLoadChanged = lambda; };
+	virtual unsigned int OnConsumerLoadChange(function<void(PowerConsumer*)> lambda);
 
 	/**
 	* \brief register lambda that fires when the running state of this consumer changes.
 	* \param lambda Lambda function that receives this as an argument.
 	* \see SetRunning()
+	* \return Id of the handler, to remove it with RemoveChildEventHandler().
 	*/
-	virtual void OnRunningChange(function<void(PowerConsumer*)> lambda) { runningChanged = lambda; };
+	virtual unsigned int OnRunningChange(function<void(PowerConsumer*)> lambda);
 
 protected:
-	double maxpowerconsumption = -1;
-	double maxconsumercurrent = -1;
-	double consumercurrent = -1;
-	double consumerload = -1;
-	double consumerresistance = -1;
-	double standbypower = -1;
-	double minimumload = -1;
-	bool running = true;
-
+	CONSUMER_SOLVER_STATE *consumerstate = NULL;		//!< Per-frame state, allocated from the consumer table.
 
 	/**
 	 * \brief recalculates the consumers resistance and power consumption and registers a statechange with the parent.
 	 */
 	void calculateNewProperties();
 
-	// Events
-	function<void(PowerConsumer*)> consumerLoadChanged = NULL;
-	function<void(PowerConsumer*)> runningChanged = NULL;
+	/**
+	 * \brief recalculates the consumers resistance and power consumption without notifying the parent.
+	 */
+	void updateProperties();
+
+	/**
+	 * \brief Sets a new load and recalculates the properties, without notifying the parent or raising events.
+	 * \return False if the load is below the minimum load, in which case the load was set to 0.
+	 */
+	bool applyConsumerLoad(double load);
+
+	/**
+	 * \brief Raises the load change event through the event queue, or fires it directly if there is none.
+	 * \param oldload The load before the change.
+	 */
+	void raiseConsumerLoadEvent(double oldload);
+
+	/**
+	 * \brief Fires the running change event if the running state differs from before.
+	 * \param wasrunning The running state before the change.
+	 */
+	void fireRunningEvent(bool wasrunning);
+
+	/**
+	 * \brief Fires the load change event if the load differs from before.
+	 * \param oldload The load before the change.
+	 */
+	void fireConsumerLoadEvent(double oldload);
+
 private:
 	unsigned int locationid = 0;
 	bool global = false;
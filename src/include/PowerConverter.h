@@ -11,7 +11,8 @@ public:
 				   double conversionefficiency,
 		     	   double internalresistance,
 		           unsigned int location_id,
-            	   bool global = false);
+            	   bool global = false,
+				   pmr::memory_resource *resource = pmr::get_default_resource());
 
 	~PowerConverter();
 
@@ -27,6 +28,27 @@ public:
 	 */
 	virtual void SetConversionEfficiency(double efficiency);
 
+	/**
+	 * \brief The demand this converter places on its input side for a given output.
+	 * Depends only on the voltages and the efficiency, not on any state, so demand can be pushed from the output circuit to the input circuit in a single step.
+	 * \param amps Current at the output voltage, in Amperes.
+	 * \return The current drawn from the input circuit to provide it, in Amperes.
+	 */
+	double GetInputCurrentForOutput(double amps);
+
+	/**
+	 * \return The circuit this converter draws its power from, or NULL if its input side isn't connected.
+	 */
+	PowerCircuit *GetInputCircuit();
+
+	/**
+	 * \brief Checks the output of this converter against what its input circuit can supply as of its last solve.
+	 * Demand is pushed to the input circuit after the output circuit was solved, so if the input circuit couldn't meet it,
+	 * or could now supply more than the output was limited to, the output circuit has to be solved again.
+	 * \return True if the output circuit has to be solved again.
+	 */
+	bool UpdateInputLimit();
+
 	//PowerParent implementation
 	virtual bool CanConnectToChild(PowerChild *child, bool bidirectional = false);
 	
@@ -38,8 +60,6 @@ public:
 	//PowerChild implementation
 	virtual bool CanConnectToParent(PowerParent *parent, bool bidirectional = false);
 
-	virtual void ConnectChildToParent(PowerParent *parent, bool bidirectional = true);
-
 	//PowerSource Implementation
 	virtual void SetRequestedCurrent(double amps);
 
@@ -48,7 +68,6 @@ public:
 
 protected:
 	double conversionefficiency = 0;
-	PowerCircuit *childcircuit;
 
 	/**
 	 * \brief Converts current at output voltage to current at input voltage.
@@ -0,0 +1,126 @@
+#pragma once
+
+/**
+ * \brief Slab allocator for the elements a PowerCircuitManager creates through its factories.
+ * Elements are constructed in place in slabs of SLAB_SIZE, so the elements of one manager sit next to each other in memory
+ * instead of being scattered across the heap. Destroyed elements leave their slot to the next element of the same type.
+ * \tparam T The most derived type of element kept in this pool.
+ * \note Not thread safe. Elements in a pool must never be deleted with delete!
+ */
+template<class T> class PowerElementPool
+{
+public:
+	/**
+	 * \param resource The memory resource the slabs are allocated from.
+	 */
+	PowerElementPool(pmr::memory_resource *resource)
+		: resource(resource), slabs(resource), freeslots(resource) {};
+
+	/**
+	 * \brief Destroys all elements still in the pool.
+	 */
+	~PowerElementPool()
+	{
+		Clear();
+	}
+
+	/**
+	 * \brief Constructs a new element in the pool.
+	 * \param args The arguments passed to the constructor of T.
+	 * \return The new element.
+	 */
+	template<class... ARGS> T *Create(ARGS&&... args)
+	{
+		if (freeslots.size() == 0)
+		{
+			POOL_SLOT *slab = (POOL_SLOT*)resource->allocate(sizeof(POOL_SLOT) * SLAB_SIZE, alignof(POOL_SLOT));
+			for (unsigned int i = 0; i < SLAB_SIZE; ++i)
+			{
+				new (slab + i) POOL_SLOT();
+			}
+			slabs.push_back(slab);
+			//pushed in reverse, so slots are handed out in the order they are laid out in memory.
+			for (unsigned int i = SLAB_SIZE; i > 0; --i)
+			{
+				freeslots.push_back(slab + (i - 1));
+			}
+		}
+		POOL_SLOT *slot = freeslots.back();
+		T *element = new (slot->storage) T(forward<ARGS>(args)...);
+		freeslots.pop_back();
+		slot->live = true;
+		return element;
+	}
+
+	/**
+	 * \brief Destroys an element and returns its slot to the pool.
+	 */
+	void Destroy(T *element)
+	{
+		assert(Owns(element) && "Attempting to destroy an element that is not in this pool!");
+		POOL_SLOT *slot = (POOL_SLOT*)element;
+		element->~T();
+		slot->live = false;
+		freeslots.push_back(slot);
+	}
+
+	/**
+	 * \return True if the element lives in this pool.
+	 */
+	bool Owns(T *element)
+	{
+		POOL_SLOT *slot = (POOL_SLOT*)element;
+		for (auto i = slabs.begin(); i != slabs.end(); ++i)
+		{
+			if (slot >= (*i) && slot < (*i) + SLAB_SIZE)
+			{
+				return slot->live;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * \brief Destroys all elements and releases the memory of the pool, one slab at a time.
+	 */
+	void Clear()
+	{
+		for (auto i = slabs.begin(); i != slabs.end(); ++i)
+		{
+			for (unsigned int j = 0; j < SLAB_SIZE; ++j)
+			{
+				if ((*i)[j].live)
+				{
+					((T*)(*i)[j].storage)->~T();
+				}
+			}
+			resource->deallocate((*i), sizeof(POOL_SLOT) * SLAB_SIZE, alignof(POOL_SLOT));
+		}
+		slabs.clear();
+		freeslots.clear();
+	}
+
+	/**
+	 * \return The number of elements in the pool.
+	 */
+	unsigned int GetSize()
+	{
+		return slabs.size() * SLAB_SIZE - freeslots.size();
+	}
+
+private:
+	/**
+	 * \brief Storage for one element. The storage comes first, so an element and its slot share their address.
+	 */
+	struct POOL_SLOT
+	{
+		alignas(T) unsigned char storage[sizeof(T)];
+		bool live = false;							//!< Whether an element is constructed in this slot.
+	};
+
+	static const unsigned int SLAB_SIZE = 64;
+
+	pmr::memory_resource *resource = NULL;
+	pmr::vector<POOL_SLOT*> slabs;
+	pmr::vector<POOL_SLOT*> freeslots;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+class PowerChild;
+class PowerParent;
+class PowerBus;
+class PowerSource;
+class PowerConsumer;
+
+/**
+ * \brief Kinds of elements, to select elements by. An element can be of several kinds, e.g. a rechargable source is a source, a consumer and a chargable.
+ */
+enum POWER_ELEMENT_KIND
+{
+	PEK_BUS = 1,
+	PEK_SOURCE = 2,
+	PEK_CONSUMER = 4,
+	PEK_CHARGABLE = 8
+};
+
+/**
+ * \brief An entry of the PowerElementRegistry.
+ */
+struct REGISTRY_SLOT
+{
+	PowerChild *child = NULL;
+	PowerParent *parent = NULL;
+	unsigned int kinds = 0;						//!< Combination of POWER_ELEMENT_KIND flags, determined once on registration.
+	unsigned int generation = 1;				//!< Incremented every time the slot is freed. Never 0, so no handle is ever 0.
+};
+
+
+/**
+ * \brief Hands out 32-bit handles for the elements of a PowerCircuitManager, and resolves them back to elements.
+ * A handle consists of a slot index and the generation of the slot. When an element is deleted, its slot is reused for the next
+ * element, but with a new generation, so handles of deleted elements resolve to NULL instead of to whatever took their place.
+ * Handles can therefore be stored and passed to other threads freely, but only resolved on the simulation thread.
+ * Use GetHandleIndex() to key dense arrays with them.
+ * Buses are registered when they are created, all other elements when they are first connected to a bus.
+ * Elements stay registered until they are deleted, even if they are disconnected in the meantime.
+ */
+class PowerElementRegistry
+{
+	friend class PowerCircuitManager;
+	friend class PowerChild;
+	friend class PowerParent;
+	friend class PowerBus;
+public:
+
+	/**
+	 * \return The handle of the element, or 0 if it isn't registered here.
+	 */
+	POWER_HANDLE GetHandle(PowerChild *element);
+
+	/**
+	 * \return The handle of the element, or 0 if it isn't registered here.
+	 */
+	POWER_HANDLE GetHandle(PowerParent *element);
+
+	/**
+	 * \brief Gets the handle of any element, no matter the type of the pointer.
+	 * \return The handle of the element, or 0 if it isn't registered here.
+	 */
+	template<class T> POWER_HANDLE GetHandle(T *element)
+	{
+		//elements that are children carry the handle on their child side, pure parents on their parent side.
+		PowerChild *child = dynamic_cast<PowerChild*>(element);
+		if (child != NULL)
+		{
+			return GetHandle(child);
+		}
+		return GetHandle(dynamic_cast<PowerParent*>(element));
+	}
+
+	/**
+	 * \return True if the handle identifies an element that still exists.
+	 */
+	bool IsValid(POWER_HANDLE handle);
+
+	/**
+	 * \return The child side of the element, or NULL if the handle is outdated or the element isn't a child.
+	 */
+	PowerChild *ResolveChild(POWER_HANDLE handle);
+
+	/**
+	 * \return The parent side of the element, or NULL if the handle is outdated or the element isn't a parent.
+	 */
+	PowerParent *ResolveParent(POWER_HANDLE handle);
+
+	/**
+	 * \return The bus, or NULL if the handle is outdated or doesn't identify a bus.
+	 */
+	PowerBus *ResolveBus(POWER_HANDLE handle);
+
+	/**
+	 * \return The source, or NULL if the handle is outdated or doesn't identify a source.
+	 * \note Rechargable sources and converters are sources as well as consumers.
+	 */
+	PowerSource *ResolveSource(POWER_HANDLE handle);
+
+	/**
+	 * \return The consumer, or NULL if the handle is outdated or doesn't identify a consumer.
+	 * \note Rechargable sources and converters are sources as well as consumers.
+	 */
+	PowerConsumer *ResolveConsumer(POWER_HANDLE handle);
+
+	/**
+	 * \return The number of registered elements.
+	 */
+	unsigned int GetSize();
+
+	/**
+	 * \brief Gets the handles of all elements of certain kinds, in the order of their slots.
+	 * Use to build the handle lists for the bulk queries of PowerCircuitManager.
+	 * \param kinds Combination of POWER_ELEMENT_KIND flags. Elements of any of these kinds are included.
+	 * \param OUT_handles Array that can hold at least maxcount handles. May be NULL if maxcount is 0.
+	 * \param maxcount The maximum number of handles to write.
+	 * \return The number of matching elements, which may be more than were written.
+	 */
+	unsigned int GetHandles(unsigned int kinds, POWER_HANDLE *OUT_handles, unsigned int maxcount);
+
+	/**
+	 * \return The slot index of a handle. Indices are dense and reused, so they can be used to index arrays.
+	 *	No two existing elements share an index.
+	 */
+	static unsigned int GetHandleIndex(POWER_HANDLE handle);
+
+private:
+	/**
+	 * \param resource The memory resource the slots are allocated from.
+	 */
+	PowerElementRegistry(pmr::memory_resource *resource);
+	~PowerElementRegistry();
+
+	/**
+	 * \brief Registers an element, unless it is already registered.
+	 * \param child The child side of the element, NULL if it isn't a child.
+	 * \param parent The parent side of the element, NULL if it isn't a parent.
+	 * \return The handle of the element.
+	 * \note An element that is registered with another manager stays registered there.
+	 */
+	POWER_HANDLE registerElement(PowerChild *child, PowerParent *parent);
+
+	/**
+	 * \brief Removes an element from the registry and invalidates its handle.
+	 */
+	void unregisterElement(POWER_HANDLE handle);
+
+	/**
+	 * \brief Clears the registration of all elements, so they don't reference the registry after it's gone.
+	 */
+	void detachAll();
+
+	/**
+	 * \return The slot the handle refers to, or NULL if the handle is outdated.
+	 */
+	REGISTRY_SLOT *getSlot(POWER_HANDLE handle);
+
+	static const unsigned int INDEX_BITS = 20;
+	static const unsigned int INDEX_MASK = (1 << INDEX_BITS) - 1;
+	static const unsigned int GENERATION_MASK = (1 << (32 - INDEX_BITS)) - 1;
+
+	pmr::vector<REGISTRY_SLOT> slots;
+	pmr::vector<unsigned int> freeslots;				//!< Indices of slots that are not in use.
+};
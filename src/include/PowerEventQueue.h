@@ -0,0 +1,90 @@
+#pragma once
+#include <unordered_set>
+
+class PowerEventStream;
+
+/**
+ * \brief The states of an element that events are fired for.
+ * One state can fire different events, e.g. PEVT_CHILD_SWITCH fires either the switch in or the switch out event.
+ */
+enum POWER_EVENT_TYPE
+{
+	PEVT_CHILD_SWITCH,
+	PEVT_PARENT_SWITCH,
+	PEVT_CONSUMER_RUNNING,
+	PEVT_CONSUMER_LOAD,
+	PEVT_SOURCE_LOAD,
+	PEVT_BUS_CURRENT,
+	PEVT_CHARGE,
+	PEVT_COUNT
+};
+
+/**
+ * \brief An event recorded during evaluation.
+ */
+struct POWER_EVENT_RECORD
+{
+	POWER_EVENT_TYPE type;
+	void *element;								//!< The element, as the type that declares the event (e.g. PowerChild for PEVT_CHILD_SWITCH).
+	double oldvalue;							//!< The state before the first change in this evaluation. Bools are stored as 0 or 1.
+};
+
+
+/**
+ * \brief Collects the events of all elements in a PowerCircuitManager during evaluation, and fires them afterwards.
+ * While recording, only the first change of a state is recorded, together with the value before it. On dispatch, the events are fired
+ * for the net change between that value and the final state, so a state that changed back and forth fires nothing at all.
+ * Handlers therefore never run in the middle of the solver, and any changes they make are picked up by the next evaluation.
+ * \note Outside of evaluation, events are fired immediately, as before.
+ * Every event that is fired is also written to the managers PowerEventStream, if it has one.
+ */
+class PowerEventQueue
+{
+	friend class PowerCircuitManager;
+public:
+
+	/**
+	 * \brief Fires the events for a change of state, or records the change if the queue is recording.
+	 * \param type The state that changed.
+	 * \param element The changed element, as the type that declares the event.
+	 * \param oldvalue The value of the state before the change.
+	 */
+	void Raise(POWER_EVENT_TYPE type, void *element, double oldvalue);
+
+	/**
+	 * \return True while events are being recorded rather than fired.
+	 */
+	bool IsRecording();
+
+private:
+	/**
+	 * \param resource The memory resource the records are allocated from.
+	 */
+	PowerEventQueue(pmr::memory_resource *resource);
+	~PowerEventQueue();
+
+	/**
+	 * \brief Starts recording events.
+	 */
+	void startRecording();
+
+	/**
+	 * \brief Stops recording and fires events for all recorded changes, in the order they first happened.
+	 */
+	void dispatch();
+
+	/**
+	 * \brief Fires the events for a recorded change and writes it to the stream.
+	 */
+	void fire(const POWER_EVENT_RECORD &record);
+
+	/**
+	 * \brief Writes a change to the stream, if it is a change at all.
+	 */
+	void writeToStream(const POWER_EVENT_RECORD &record);
+
+	bool recording = false;
+	pmr::vector<POWER_EVENT_RECORD> records;
+	pmr::vector<pmr::unordered_set<void*>> recorded;	//!< Elements that already have a record, one set per type.
+	PowerEventStream *stream = NULL;			//!< Stream to publish fired events to, NULL if there's no stream.
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+
+class PowerElementRegistry;
+
+/**
+ * \brief An event as seen by threads reading a PowerEventStream.
+ * Plain data without pointers, so it can be copied around and stored freely.
+ */
+struct POWER_EVENT_STREAM_RECORD
+{
+	unsigned long long frame;					//!< The evaluation during or after which the event happened.
+	POWER_HANDLE element;						//!< Handle of the element, see PowerElementRegistry.
+	unsigned int type;							//!< The POWER_EVENT_TYPE of the state that changed.
+	double oldvalue;							//!< The state before the change. Bools are stored as 0 or 1.
+	double newvalue;							//!< The state after the change.
+	double limit;								//!< For bus currents the maximum current, for charge the low charge limit, 0 otherwise.
+};
+
+
+/**
+ * \brief Fixed-size single-producer/single-consumer ring buffer that publishes the events of a PowerCircuitManager to one other thread.
+ * The simulation thread writes every event that is fired to the stream. If the reader doesn't keep up and the buffer is full,
+ * new events are dropped and counted as overflow. Neither side ever blocks.
+ * Enable with PowerCircuitManager::EnableEventStream().
+ */
+class PowerEventStream
+{
+	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
+public:
+
+	/**
+	 * \brief Takes the oldest events out of the stream.
+	 * \param OUT_records Array that can hold at least maxcount records.
+	 * \param maxcount The maximum number of records to read.
+	 * \return The number of records written to OUT_records.
+	 * \note Only call from the single reading thread!
+	 */
+	unsigned int Read(POWER_EVENT_STREAM_RECORD *OUT_records, unsigned int maxcount);
+
+	/**
+	 * \return The number of events that were dropped because the buffer was full. Can be called from any thread.
+	 */
+	unsigned long long GetOverflowCount();
+
+	/**
+	 * \return The number of records the stream can hold.
+	 */
+	unsigned int GetCapacity();
+
+private:
+	/**
+	 * \param capacity The number of records the stream can hold. Will be rounded up to a power of two.
+	 * \param registry The registry of the manager, to identify elements with.
+	 */
+	PowerEventStream(unsigned int capacity, PowerElementRegistry *registry);
+	~PowerEventStream();
+
+	/**
+	 * \brief Appends a record to the stream, or counts an overflow if it is full.
+	 */
+	void write(const POWER_EVENT_STREAM_RECORD &record);
+
+	static const unsigned int CACHE_LINE = 64;
+
+	//the read and write positions live on their own cache lines, so the two threads don't invalidate each other's cache on every access.
+	alignas(CACHE_LINE) atomic<unsigned long long> writeposition;	//!< Written by the simulation thread only.
+	unsigned long long cachedreadposition = 0;						//!< The simulation threads last look at readposition, to avoid touching the readers cache line on every write.
+	alignas(CACHE_LINE) atomic<unsigned long long> readposition;	//!< Written by the reading thread only.
+	alignas(CACHE_LINE) atomic<unsigned long long> overflowcount;
+
+	alignas(CACHE_LINE) POWER_EVENT_STREAM_RECORD *records = NULL;
+	unsigned int capacity = 0;
+	unsigned int mask = 0;
+	unsigned long long frame = 0;									//!< The frame number written to new records.
+	PowerElementRegistry *registry = NULL;							//!< Identifies the elements in the records.
+};
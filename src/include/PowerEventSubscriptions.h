@@ -0,0 +1,161 @@
+#pragma once
+
+class PowerChild;
+class PowerParent;
+class PowerConsumer;
+class PowerSource;
+class PowerSourceChargable;
+class PowerBus;
+
+/**
+ * \brief A list of handlers that are all invoked when an event fires.
+ * \tparam T The type of element the handlers receive.
+ */
+template<class T> class PowerDelegate
+{
+public:
+
+	/**
+	 * \brief Adds a handler.
+	 * \param id Identifier to remove the handler with later on.
+	 */
+	void Add(unsigned int id, function<void(T*)> handler)
+	{
+		handlers.push_back(make_pair(id, handler));
+	}
+
+	/**
+	 * \brief Removes a handler.
+	 * \return True if a handler with that id was found.
+	 * \note Safe to call from within a handler, including the one being removed.
+	 */
+	bool Remove(unsigned int id)
+	{
+		for (auto i = handlers.begin(); i != handlers.end(); ++i)
+		{
+			if (i->first == id)
+			{
+				if (invoking > 0)
+				{
+					//don't pull the vector out from under Invoke(), just clear the handler and clean up afterwards.
+					i->second = nullptr;
+					removedduringinvoke = true;
+				}
+				else
+				{
+					handlers.erase(i);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * \brief Invokes all handlers in the order they were added.
+	 * \note Handlers added while invoking will only be invoked the next time.
+	 */
+	void Invoke(T *element)
+	{
+		invoking++;
+		unsigned int count = handlers.size();
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			if (handlers[i].second)
+			{
+				handlers[i].second(element);
+			}
+		}
+		invoking--;
+
+		if (invoking == 0 && removedduringinvoke)
+		{
+			handlers.erase(remove_if(handlers.begin(), handlers.end(), [](const pair<unsigned int, function<void(T*)>> &handler) { return !handler.second; }), handlers.end());
+			removedduringinvoke = false;
+		}
+	}
+
+	/**
+	 * \return True if no handlers are registered.
+	 */
+	bool IsEmpty()
+	{
+		return handlers.size() == 0;
+	}
+
+private:
+	vector<pair<unsigned int, function<void(T*)>>> handlers;
+	unsigned int invoking = 0;						//!< Depth of nested Invoke() calls.
+	bool removedduringinvoke = false;
+};
+
+
+/**
+ * \brief Event handlers of the PowerChild side of an element.
+ * Allocated when the first handler is registered, so elements nobody listens to only carry a NULL pointer.
+ */
+struct CHILD_SUBSCRIPTIONS
+{
+	PowerDelegate<PowerChild> switchin;
+	PowerDelegate<PowerChild> switchout;
+	PowerDelegate<PowerConsumer> loadchanged;
+	PowerDelegate<PowerConsumer> runningchanged;
+	unsigned int lastid = 0;						//!< The last handler id handed out.
+
+	/**
+	 * \brief Adds a handler to one of the delegates.
+	 * \return The id of the new handler, unique among all handlers of this element side.
+	 */
+	template<class T> unsigned int Add(PowerDelegate<T> &delegate, function<void(T*)> handler)
+	{
+		lastid++;
+		delegate.Add(lastid, handler);
+		return lastid;
+	}
+
+	/**
+	 * \return True if a handler with the id was found and removed.
+	 */
+	bool Remove(unsigned int id)
+	{
+		return switchin.Remove(id) || switchout.Remove(id) || loadchanged.Remove(id) || runningchanged.Remove(id);
+	}
+};
+
+
+/**
+ * \brief Event handlers of the PowerParent side of an element.
+ * Allocated when the first handler is registered, so elements nobody listens to only carry a NULL pointer.
+ */
+struct PARENT_SUBSCRIPTIONS
+{
+	PowerDelegate<PowerParent> switchin;
+	PowerDelegate<PowerParent> switchout;
+	PowerDelegate<PowerSource> loadchanged;
+	PowerDelegate<PowerSourceChargable> chargelow;
+	PowerDelegate<PowerSourceChargable> chargeempty;
+	PowerDelegate<PowerBus> currentchanged;
+	PowerDelegate<PowerBus> maxcurrenthigh;
+	PowerDelegate<PowerBus> maxcurrentok;
+	unsigned int lastid = 0;						//!< The last handler id handed out.
+
+	/**
+	 * \brief Adds a handler to one of the delegates.
+	 * \return The id of the new handler, unique among all handlers of this element side.
+	 */
+	template<class T> unsigned int Add(PowerDelegate<T> &delegate, function<void(T*)> handler)
+	{
+		lastid++;
+		delegate.Add(lastid, handler);
+		return lastid;
+	}
+
+	/**
+	 * \return True if a handler with the id was found and removed.
+	 */
+	bool Remove(unsigned int id)
+	{
+		return switchin.Remove(id) || switchout.Remove(id) || loadchanged.Remove(id) || chargelow.Remove(id) ||
+			chargeempty.Remove(id) || currentchanged.Remove(id) || maxcurrenthigh.Remove(id) || maxcurrentok.Remove(id);
+	}
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+class PowerParent;
+class PowerBus;
+struct TOPOLOGY_SNAPSHOT;
+
+/**
+ * \brief Solves the current flow through the buses of a circuit by nodal analysis, taking into account the resistance of the buses.
+ * Every source and bus is a node, every connection between a bus and its parents is a link. The output current of sources is injected
+ * into their node, the current drawn by the consumers of a bus is taken out of it. Solving the conductance matrix of the links for the
+ * node potentials gives the current through every link, so unlike the reachability table, this also works for meshed circuits.
+ * The matrix is factorized as L * D * L^T. The fill-reducing ordering and the sparsity pattern of L only depend on the structure of the
+ * circuit and are computed once in Analyze(). The numbers only change with the resistance of the buses, so load changes merely solve
+ * the factorization again for new injections.
+ * Owned by a PowerCircuit and used instead of its reachability table if the nodal solver is enabled in the PowerCircuitManager.
+ */
+class PowerNodalSolver
+{
+public:
+	/**
+	 * \param resource The memory resource the solver is allocated from.
+	 */
+	PowerNodalSolver(pmr::memory_resource *resource);
+	~PowerNodalSolver();
+
+	/**
+	 * \brief Computes the links, the elimination order and the sparsity pattern of the factorization of a circuit.
+	 * \param snapshot The structure of the circuit. Not taken over, the caller still has to delete it.
+	 */
+	void Analyze(TOPOLOGY_SNAPSHOT *snapshot);
+
+	/**
+	 * \brief Removes all nodes and links from the solver.
+	 */
+	void Clear();
+
+	/**
+	 * \brief Refactorizes the conductance matrix if the resistance of any bus changed, and solves it for the current state of all elements.
+	 * \param voltage The voltage of the circuit.
+	 */
+	void Update(double voltage);
+
+	/**
+	 * \return The current flowing through a bus as of the last Update(), in Amperes. 0 if the bus is not in the solver.
+	 */
+	double GetThroughCurrent(PowerBus *bus);
+
+	/**
+	 * \return The number of links between nodes.
+	 */
+	unsigned int GetLinkCount();
+
+	/**
+	 * \return The number of off-diagonal entries in the factor L.
+	 */
+	unsigned int GetFactorSize();
+
+	/**
+	 * \return How often the conductance matrix was factorized since the last Analyze().
+	 */
+	unsigned int GetFactorizationCount();
+
+private:
+	static constexpr double MIN_LINK_RESISTANCE = 1e-6;		//!< Links without resistance would make the matrix singular, so they are given this much, in Ohm.
+
+	/**
+	 * \brief Orders the unknowns so eliminating them creates as little fill-in as possible, by always eliminating the node with the fewest neighbours.
+	 * \param adjacency The sorted neighbours of every unknown. Destroyed in the process.
+	 * \param OUT_order Receives the unknowns in the order they should be eliminated.
+	 */
+	static void orderMinimumDegree(vector<vector<unsigned int>> &adjacency, vector<unsigned int> &OUT_order);
+
+	/**
+	 * \brief Computes the elimination tree and the number of entries in every column of L.
+	 */
+	void analyzeFactor();
+
+	/**
+	 * \brief Fills the conductance matrix from the current link resistances and factorizes it.
+	 */
+	void factorize();
+
+	/**
+	 * \return The resistance of a link as of now, in Ohm.
+	 */
+	double getLinkResistance(unsigned int link);
+
+	pmr::vector<PowerParent*> elements;				//!< All nodes, sources first, then buses.
+	unsigned int sourcecount = 0;					//!< The number of sources at the start of elements.
+	pmr::vector<unsigned int> linkfirst;			//!< The element with the lower index of every link.
+	pmr::vector<unsigned int> linksecond;			//!< The element with the higher index of every link. Always a bus.
+	pmr::vector<double> linkresistances;			//!< The resistance of every link the matrix was last factorized with.
+	pmr::vector<int> unknowns;						//!< The position of every element in the elimination order, or -1 for the node every group of connected elements is measured against.
+	pmr::vector<unsigned int> diagonals;			//!< The position of the diagonal entry of every unknown in matrixvalues.
+	pmr::vector<int> linkentries;					//!< The position of the off-diagonal entry of every link in matrixvalues, or -1 if either end is not an unknown.
+
+	//the upper triangle of the permuted conductance matrix, column by column. Column k holds the rows <= k.
+	pmr::vector<unsigned int> matrixoffsets;
+	pmr::vector<unsigned int> matrixrows;
+	pmr::vector<double> matrixvalues;
+
+	//the factorization. Column k of L holds the rows > k.
+	pmr::vector<int> etree;							//!< The parent of every column in the elimination tree, or -1 for roots.
+	pmr::vector<unsigned int> factoroffsets;
+	pmr::vector<unsigned int> factorrows;
+	pmr::vector<double> factorvalues;
+	pmr::vector<double> diagonal;					//!< D.
+
+	pmr::vector<double> solution;					//!< Injections going in, potentials of the unknowns coming out of the solve.
+	pmr::vector<double> potentials;					//!< The potential of every element relative to its reference node, as of the last update.
+	pmr::vector<double> throughcurrents;			//!< The current flowing through each bus as of the last update.
+	unsigned int factorizations = 0;
+	bool factorized = false;
+};
@@ -1,8 +1,14 @@
 #pragma once
+#include "PowerSmallVector.h"
+#include "PowerSpan.h"
 
 class PowerChild;
 class PowerCircuit;
-class PowerSubCircuit;
+class PowerReachabilityTable;
+class PowerEventQueue;
+class PowerElementRegistry;
+struct PARENT_SUBSCRIPTIONS;
+struct PARENT_SOLVER_STATE;
 
 /**
  * \brief Abstract base class for classes that can be parents in a circuits hierarchy (i.e. feed power to other instances).
@@ -11,14 +17,18 @@ class PowerParent
 {
 	friend class PowerChild;
 	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
+	friend class PowerElementRegistry;
+	friend class PowerReachabilityTable;
 public:
 
 	/**
 	 * \param type The type of this parent
 	 * \param minvoltage The minimum voltage at which this parent can provide power.
 	 * \param maxvoltage The maximum voltage at which this parent can provide power.
+	 * \param resource The memory resource the adjacency of this parent is allocated from.
 	 */
-	PowerParent(POWERPARENT_TYPE type, double minvoltage, double maxvoltage, bool switchable = true);
+	PowerParent(POWERPARENT_TYPE type, double minvoltage, double maxvoltage, bool switchable = true, pmr::memory_resource *resource = pmr::get_default_resource());
 	virtual ~PowerParent();
 
 	/**
@@ -48,6 +58,11 @@ public:
 	 */
 	virtual void GetChildren(vector<PowerChild*> &OUT_children);
 
+	/**
+	 * \return The children of this parent, without copying them. Invalidated by connecting or disconnecting the parent.
+	 */
+	PowerSpan<PowerChild*> GetChildren();
+
 	/**
 	* \return The voltage range and current voltage of this parent.
 	* \note If only the current voltage is needed, use GetCurrentOutputVoltage for better performance!
@@ -126,14 +141,14 @@ public:
 	virtual void SetCircuit(PowerCircuit *circuit);
 
 	/**
-	 * Tells this parent that a subcircuit is containing it, enabling it to get statechange notifications.
+	 * Tells this parent that a reachability table is indexing it, so the table can be told when the parent is destroyed.
 	 */
-	void RegisterContainingSubCircuit(PowerSubCircuit *subcircuit);
+	void RegisterReachabilityTable(PowerReachabilityTable *table);
 
 	/**
-	* Tells this parent that a subcircuit is containing it no longer exists and shouldn't receive status updates anymore.
+	* Tells this parent that a reachability table indexing it no longer does.
 	*/
-	void UnregisterContainingSubCircuit(PowerSubCircuit *subcircuit);
+	void UnregisterReachabilityTable(PowerReachabilityTable *table);
 
 
 	/**
@@ -144,39 +159,60 @@ public:
 	/**
 	* \brief register lambda that fires when parent is switched in.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnParentSwitchIn(function<void(PowerParent*)> lambda) { parentSwitchIn = lambda; };
+	virtual unsigned int OnParentSwitchIn(function<void(PowerParent*)> lambda);
 	
 	/**
 	* \brief register lambda that fires when parent is switched out.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnParentSwitchOut(function<void(PowerParent*)> lambda) { parentSwitchOut = lambda; };
+	virtual unsigned int OnParentSwitchOut(function<void(PowerParent*)> lambda);
 
-protected:
-	vector<PowerChild*> children;
+	/**
+	 * \brief Removes a handler registered with any of the events of the parent side of this element.
+	 * \param id The id returned when the handler was registered.
+	 * \return True if the handler was found.
+	 */
+	bool RemoveParentEventHandler(unsigned int id);
 
-	bool child_state_changed = false;
-	bool parentswitchedin = true;				//!< whether this parent is switched in.
-	bool parentautoswitch = false;				//!< whether this parent is set to switch in and out on demand.
+protected:
+	PARENT_SOLVER_STATE *parentstate = NULL;	//!< Per-frame state, part of the state of the implementing kind. Set by the implementing class.
+	PowerSmallVector<PowerChild*, 2> children;	//!< Inline for the common case of one or two children.
 
-	VOLTAGE_INFO outputvoltage;
+	VOLTAGE_INFO outputvoltagerange;			//!< Minimum and maximum output voltage. The current voltage is part of parentstate.
 
 	/**
 	 * \brief Registers that the state of a child has changed.
 	 */
 	void RegisterChildStateChange();
 
-	function<void(PowerParent*)> parentSwitchIn = NULL;
-	function<void(PowerParent*)> parentSwitchOut = NULL;
-	
-	PowerCircuit *circuit = NULL;			//!< The circuit this parent is a part of.
-	vector<PowerSubCircuit*> containing_subcircuits;	//!< Subcircuits containing this parent.
+	/**
+	 * \return The event queue of the manager this parent is managed by, or NULL if it isn't part of a circuit.
+	 */
+	PowerEventQueue *getEventQueue();
+
+	/**
+	 * \brief Fires the switch in or switch out event if the switch state differs from before.
+	 * \param wasswitchedin The switch state before the change.
+	 */
+	void fireParentSwitchEvent(bool wasswitchedin);
+
+	/**
+	 * \return The event handlers of this parent. Allocated on first call.
+	 */
+	PARENT_SUBSCRIPTIONS *getParentSubscriptions();
+
+	PARENT_SUBSCRIPTIONS *parentsubscriptions = NULL;	//!< Registered event handlers, NULL until the first one is registered.
+	PowerSmallVector<PowerReachabilityTable*, 1> reachabilitytables;	//!< Tables indexing this parent. Usually just the one of its circuit, more while a rebuild is pending.
 
 
 private:
 	POWERPARENT_TYPE parenttype;
 	bool parentcanswitch;				//!< whether this parent can be switched at all.
+	PowerElementRegistry *registry = NULL;	//!< The registry this element is registered with, NULL if it isn't registered.
+	POWER_HANDLE handle = 0;			//!< The handle of this element in registry.
 
 };
 
@@ -0,0 +1,118 @@
+#pragma once
+
+class PowerParent;
+class PowerBus;
+struct TOPOLOGY_RESULT;
+
+/**
+ * \brief Which sources and buses feed current into every bus of a circuit, and how much of it.
+ * Every parent of a bus is a feeding edge. The elements upstream of an edge are stored as a bitset over the elements of the circuit,
+ * sources first, then buses. All edges of a circuit share a single array with the contribution of every element: the output current
+ * of a source, or the negative current drawn by the consumers on a bus. The surplus of an edge is the masked sum of that array,
+ * and the current through a bus is the sum of the positive surpluses of its edges.
+ * Surpluses are kept up to date incrementally: when the contribution of an element changes, the difference is added to every edge
+ * downstream of it, and only the buses fed by those edges are summed up again.
+ * If the topology was reduced, edges coming out of chains and leaves of buses have no mask. Their surplus is derived from the edge
+ * feeding the bus they come from, plus the contribution of that bus.
+ * Owned by a PowerCircuit and rebuilt whenever its structure changes.
+ */
+class PowerReachabilityTable
+{
+public:
+	/**
+	 * \param resource The memory resource the table is allocated from.
+	 */
+	PowerReachabilityTable(pmr::memory_resource *resource);
+	~PowerReachabilityTable();
+
+	/**
+	 * \brief Replaces the content of the table with the reachability computed by a PowerTopologyBuilder.
+	 * \param result The reachability of the circuit. Not taken over, the caller still has to delete it.
+	 * \param voltage The voltage of the circuit.
+	 */
+	void Assign(TOPOLOGY_RESULT *result, double voltage);
+
+	/**
+	 * \brief Removes all elements and edges from the table.
+	 */
+	void Clear();
+
+	/**
+	 * \brief Reads the current contribution of every element that changed its state since the last update,
+	 * and updates the through-currents of the buses downstream of them.
+	 */
+	void Update();
+
+	/**
+	 * \return The current flowing through a bus as of the last Update(), in Amperes. 0 if the bus is not in the table.
+	 */
+	double GetThroughCurrent(PowerBus *bus);
+
+	/**
+	 * \brief Removes an element that is being destroyed. Its contribution will be 0 until the table is rebuilt.
+	 */
+	void RemoveElement(PowerParent *element);
+
+	/**
+	 * \return The number of feeding edges in the table.
+	 */
+	unsigned int GetEdgeCount();
+
+	/**
+	 * \return The number of edges whose surplus is derived from another edge instead of a mask.
+	 */
+	unsigned int GetDerivedEdgeCount();
+
+	/**
+	 * \return The number of bytes occupied by the masks of all edges.
+	 */
+	unsigned int GetMaskSize();
+
+private:
+	static const unsigned int BITS_PER_WORD = 64;
+	static const unsigned int RESYNC_INTERVAL = 1024;		//!< Incremental updates between two full recalculations, so rounding errors can't accumulate.
+
+	/**
+	 * \return The sum of the contributions of all elements in a mask.
+	 */
+	double maskedSum(const unsigned long long *mask);
+
+	/**
+	 * \brief Recalculates the surplus of every edge and the through-current of every bus from scratch.
+	 */
+	void recalculateAll();
+
+	/**
+	 * \brief Adds the change of an elements contribution to every edge downstream of it, and marks the buses fed by those edges.
+	 */
+	void pushDelta(unsigned int element, double delta);
+
+	/**
+	 * \brief Sums up the surpluses of the edges feeding a bus.
+	 */
+	void recalculateThroughCurrent(unsigned int bus);
+
+	/**
+	 * \brief Recalculates the surpluses of all derived edges from their bases, and marks the buses whose edges changed.
+	 */
+	void recalculateDerived();
+
+	pmr::vector<PowerParent*> elements;				//!< All elements of the circuit, sources first, then buses. NULL for elements that were destroyed.
+	unsigned int sourcecount = 0;					//!< The number of sources at the start of elements.
+	pmr::vector<double> contributions;				//!< The current each element adds to or takes from every edge it is upstream of, in Amperes.
+	pmr::vector<unsigned int> generations;			//!< The state generation of each element at the last update.
+	pmr::vector<unsigned int> edgeoffsets;			//!< The edges feeding bus i are [edgeoffsets[i], edgeoffsets[i + 1]).
+	pmr::vector<unsigned long long> masks;			//!< Mask m occupies maskwords words starting at m * maskwords.
+	unsigned int maskwords = 0;
+	pmr::vector<unsigned int> maskedges;			//!< The edge each mask belongs to.
+	pmr::vector<int> edgebases;						//!< For derived edges, the edge they are derived from, or -1 for leaves.
+	pmr::vector<unsigned int> edgeelements;			//!< For derived edges, the element whose contribution is added to the base.
+	pmr::vector<unsigned int> derivedorder;			//!< The derived edges, bases first.
+	pmr::vector<unsigned int> edgebuses;			//!< The bus each edge feeds.
+	pmr::vector<double> edgesurpluses;				//!< The masked sum of each edge, before clamping to positive values.
+	pmr::vector<double> throughcurrents;			//!< The current flowing through each bus as of the last update.
+	pmr::vector<unsigned char> dirtybuses;			//!< Set for buses whose edges changed during the current update.
+	double voltage = -1;
+	unsigned int updatessinceresync = 0;
+	bool stale = true;								//!< True if everything has to be recalculated no matter the generations.
+};
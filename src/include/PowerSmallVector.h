@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * \brief Vector that keeps up to N entries inside the object itself, and only allocates once it grows beyond that.
+ * Used for the adjacency of elements: almost every consumer and source has exactly one parent or child, so most lists
+ * never allocate at all, and reading them doesn't leave the cache line of the element.
+ * \tparam T Type of the entries. Must be trivially copyable, the adjacency lists only ever hold pointers.
+ * \tparam N The number of entries stored inline.
+ */
+template<class T, unsigned int N> class PowerSmallVector
+{
+public:
+	typedef T *iterator;
+	typedef const T *const_iterator;
+
+	/**
+	 * \param resource The memory resource to allocate from once the list outgrows its inline storage.
+	 */
+	PowerSmallVector(pmr::memory_resource *resource = pmr::get_default_resource())
+		: resource(resource) {};
+
+	~PowerSmallVector()
+	{
+		if (data != inlinestorage)
+		{
+			resource->deallocate(data, sizeof(T) * capacity, alignof(T));
+		}
+	}
+
+	PowerSmallVector(const PowerSmallVector&) = delete;
+	PowerSmallVector &operator=(const PowerSmallVector&) = delete;
+
+	iterator begin() { return data; }
+	iterator end() { return data + count; }
+	const_iterator begin() const { return data; }
+	const_iterator end() const { return data + count; }
+	T &operator[](unsigned int i) { return data[i]; }
+	const T &operator[](unsigned int i) const { return data[i]; }
+	T &back() { return data[count - 1]; }
+	unsigned int size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	/**
+	 * \return True as long as the entries are stored inside the object.
+	 */
+	bool IsInline() const { return data == inlinestorage; }
+
+	void push_back(const T &value)
+	{
+		if (count == capacity)
+		{
+			grow();
+		}
+		data[count] = value;
+		count++;
+	}
+
+	/**
+	 * \brief Removes an entry, keeping the order of the others.
+	 * \return Iterator to the entry after the removed one.
+	 */
+	iterator erase(iterator position)
+	{
+		copy(position + 1, end(), position);
+		count--;
+		return position;
+	}
+
+	/**
+	 * \brief Removes all entries. Keeps the allocation, if there is one.
+	 */
+	void clear()
+	{
+		count = 0;
+	}
+
+private:
+	/**
+	 * \brief Moves the entries to an allocation twice the size of the current one.
+	 */
+	void grow()
+	{
+		unsigned int newcapacity = capacity * 2;
+		T *newdata = (T*)resource->allocate(sizeof(T) * newcapacity, alignof(T));
+		copy(begin(), end(), newdata);
+		if (data != inlinestorage)
+		{
+			resource->deallocate(data, sizeof(T) * capacity, alignof(T));
+		}
+		data = newdata;
+		capacity = newcapacity;
+	}
+
+	T *data = inlinestorage;
+	unsigned int count = 0;
+	unsigned int capacity = N;
+	T inlinestorage[N];
+	pmr::memory_resource *resource = NULL;
+};
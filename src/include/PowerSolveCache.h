@@ -0,0 +1,77 @@
+#pragma once
+
+class PowerSource;
+
+/**
+ * \brief A solve of a circuit, together with the inputs it was solved for.
+ */
+struct SOLVE_CACHE_ENTRY
+{
+	SOLVE_CACHE_ENTRY(pmr::memory_resource *resource)
+		: key(resource), sourcecurrents(resource), buscurrents(resource), limitedsources(resource) {};
+
+	unsigned long long hash = 0;					//!< Hash of the key, to rule out most entries without comparing keys.
+	pmr::vector<double> key;						//!< The inputs of the solve.
+	double equivalentresistance = -1;				//!< The equivalent resistance of the circuit, in Ohm.
+	double circuitcurrent = 0;						//!< The total current of the circuit, in Amperes.
+	pmr::vector<double> sourcecurrents;				//!< The output current of every source of the circuit, or -1 if the source was not involved.
+	pmr::vector<double> buscurrents;				//!< The current through every bus of the circuit.
+	pmr::vector<PowerSource*> limitedsources;		//!< The sources that limited their current.
+	unsigned long long lastused = 0;				//!< When the entry was last stored or found, for eviction.
+	bool valid = false;
+};
+
+/**
+ * \brief Remembers the last few solves of a circuit, so a circuit returning to a state it was recently in doesn't have to be solved again.
+ * The inputs of a solve are assembled into a key: the resistance of every bus and its consumers, and the availability and capacity of every source.
+ * A key is only ever matched exactly, so a found solve is exactly what solving again would produce. When the cache is full, the entry
+ * that was used least recently is replaced.
+ * Owned by a PowerCircuit and cleared whenever its structure changes.
+ */
+class PowerSolveCache
+{
+public:
+	/**
+	 * \param resource The memory resource the cache is allocated from.
+	 * \param capacity The number of solves to remember.
+	 */
+	PowerSolveCache(pmr::memory_resource *resource, unsigned int capacity = 4);
+
+	/**
+	 * \brief Clears the key, so the inputs of the next solve can be appended to it.
+	 * \return The key to append the inputs to.
+	 */
+	pmr::vector<double> &BeginKey();
+
+	/**
+	 * \return The entry solved for the key assembled since the last BeginKey(), or NULL if there is none.
+	 */
+	SOLVE_CACHE_ENTRY *Find();
+
+	/**
+	 * \brief Makes room for a solve of the key assembled since the last BeginKey(), evicting the least recently used entry if needed.
+	 * \return The entry to store the solve in. The key is already set, everything else has to be filled in by the caller.
+	 */
+	SOLVE_CACHE_ENTRY *Store();
+
+	/**
+	 * \brief Forgets all solves.
+	 */
+	void Clear();
+
+	/**
+	 * \return The number of times Find() found a solve.
+	 */
+	unsigned int GetHitCount();
+
+private:
+	/**
+	 * \return The hash of the key.
+	 */
+	unsigned long long hashKey();
+
+	pmr::vector<SOLVE_CACHE_ENTRY> entries;
+	pmr::vector<double> key;						//!< The key being assembled.
+	unsigned long long clock = 0;					//!< Increases with every Find() and Store().
+	unsigned int hits = 0;
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <mutex>
+
+class PowerCircuit;
+
+/**
+ * \file Per-frame state of the elements, kept apart from the elements themselves.
+ * Elements carry a lot of data the solver never looks at during evaluation: voltage ranges, locations, adjacency lists, event handlers.
+ * The state the solver reads and writes every frame is stored in densely packed tables instead, one per kind of element,
+ * and the element only keeps a pointer to its slot right next to its vtable. Evaluating an element therefore touches
+ * the first cache line of the element and one or two lines of its slot, rather than the whole object.
+ */
+
+/**
+ * \brief Solver state of the PowerChild side of an element. Never allocated on its own, it is always part of the state of a kind.
+ */
+struct CHILD_SOLVER_STATE
+{
+	double voltage = -1;						//!< The current input voltage.
+	bool switchedin = true;						//!< Whether the child is switched into the circuit.
+};
+
+/**
+ * \brief Solver state of the PowerParent side of an element. Never allocated on its own, it is always part of the state of a kind.
+ */
+struct PARENT_SOLVER_STATE
+{
+	PowerCircuit *circuit = NULL;				//!< The circuit the parent is a member of.
+	double voltage = -1;						//!< The current output voltage.
+	bool switchedin = true;						//!< Whether the parent is switched in.
+	bool autoswitch = false;					//!< Whether the parent switches in and out on demand.
+	bool childstatechanged = false;				//!< Whether the state of a child changed since the parent was last evaluated.
+	unsigned int generation = 0;				//!< Incremented on every change of a childs state. Subcircuits compare it against the generation they last saw.
+};
+
+/**
+ * \brief Solver state of a PowerConsumer.
+ */
+struct CONSUMER_SOLVER_STATE
+{
+	CHILD_SOLVER_STATE child;
+	double current = -1;						//!< Current flowing into the consumer, in Amperes.
+	double load = -1;							//!< Load as a fraction of 1.
+	double resistance = -1;						//!< Resistance at the current load, in Ohm.
+	double maxcurrent = -1;						//!< Current at full load, in Amperes.
+	double maxpower = -1;						//!< Power consumption at full load, in Watts.
+	double standbypower = -1;					//!< Power consumption at zero load, in Watts.
+	double minimumload = -1;					//!< Lowest load at which the consumer can operate.
+	bool running = true;
+};
+
+/**
+ * \brief Solver state of a PowerSource.
+ */
+struct SOURCE_SOLVER_STATE
+{
+	PARENT_SOLVER_STATE parent;
+	double outputcurrent = -1;					//!< Current flowing out of the source, in Amperes.
+	double maxoutputcurrent = -1;				//!< Maximum current the source can provide, in Amperes.
+	double maxpower = -1;						//!< Maximum power output, in Watts.
+	double internalresistance = -1;				//!< In Ohm.
+};
+
+/**
+ * \brief Solver state of a PowerBus.
+ */
+struct BUS_SOLVER_STATE
+{
+	CHILD_SOLVER_STATE child;
+	PARENT_SOLVER_STATE parent;
+	double current = -1;						//!< Current flowing through the bus, in Amperes.
+	double maxcurrent = -1;						//!< Maximum current the bus is designed for, in Amperes.
+	double equivalentresistance = -1;			//!< Equivalent resistance of all consumers of the bus, in Ohm.
+	double resistance = 0;						//!< Resistance of the bus itself, in Ohm. Only considered by the nodal solver.
+};
+
+/**
+ * \brief Solver state of a PowerSourceChargable, in addition to its source and consumer state.
+ */
+struct CHARGABLE_SOLVER_STATE
+{
+	double charge = -1;							//!< In Wh.
+	double maxcharge = -1;						//!< In Wh.
+	double efficiency = -1;						//!< Efficiency of the charging process.
+	double lowchargelimit = -1;					//!< Charge below which the charge low event fires, in Wh.
+	double autoswitchthreshold = 0.2;			//!< Source will not be automatically switched in to provide power if charge is below this fraction of maxcharge.
+	bool settocharging = false;					//!< if set to true, the source will attempt to charge no matter what. If set to false, autoswitch determines the behavior.
+};
+
+
+/**
+ * \brief Densely packed storage for the solver state of one kind of element.
+ * Slots are allocated in pages and never move, so elements can keep plain pointers to them.
+ * Freed slots are reused before new pages are allocated, so the table stays dense when elements come and go.
+ * \tparam T One of the *_SOLVER_STATE structs of an element kind.
+ * \note There is one table per kind for the whole process. Allocating and freeing is thread safe, accessing a slot is
+ *	up to the element owning it, as with any other member.
+ */
+template<class T> class PowerStateTable
+{
+public:
+
+	/**
+	 * \return The table of this kind of element.
+	 */
+	static PowerStateTable<T> &Get()
+	{
+		//never destroyed, so elements that outlive static destruction can still free their slots.
+		static PowerStateTable<T> *table = new PowerStateTable<T>();
+		return *table;
+	}
+
+	/**
+	 * \return A slot holding a default initialised state. Must be returned with Free().
+	 */
+	T *Allocate()
+	{
+		lock_guard<mutex> guard(lock);
+		if (freeslots.size() == 0)
+		{
+			T *page = new T[PAGE_SIZE];
+			pages.push_back(page);
+			//pushed in reverse, so slots are handed out in the order they are laid out in memory.
+			for (unsigned int i = PAGE_SIZE; i > 0; --i)
+			{
+				freeslots.push_back(page + (i - 1));
+			}
+		}
+		T *slot = freeslots.back();
+		freeslots.pop_back();
+		*slot = T();
+		return slot;
+	}
+
+	/**
+	 * \brief Returns a slot to the table.
+	 */
+	void Free(T *slot)
+	{
+		lock_guard<mutex> guard(lock);
+		freeslots.push_back(slot);
+	}
+
+	/**
+	 * \return The number of slots currently in use.
+	 */
+	unsigned int GetSize()
+	{
+		lock_guard<mutex> guard(lock);
+		return pages.size() * PAGE_SIZE - freeslots.size();
+	}
+
+private:
+	PowerStateTable() {};
+	~PowerStateTable() {};
+
+	static const unsigned int PAGE_SIZE = 256;
+
+	vector<T*> pages;
+	vector<T*> freeslots;
+	mutex lock;
+};
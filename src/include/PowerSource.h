@@ -1,8 +1,12 @@
 
-
+struct SOURCE_SOLVER_STATE;
 
 class PowerSource : public PowerParent
 {
+	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
+	friend class PowerReachabilityTable;
+	friend class PowerNodalSolver;
 public:
 
 	/**
@@ -13,8 +17,9 @@ public:
 	 * \param location_id The identifier of the objects location. Unless both objects are global,
 	 *	relationships can only be formed with objects in the same location.
 	 * \param global If true, this source can form connections to other global objects regardless of their location.
+	 * \param resource The memory resource the adjacency of this source is allocated from. Use PowerCircuitManager::CreateSource() to allocate from the resource of a manager.
 	 */
-	PowerSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global = false);
+	PowerSource(double minvoltage, double maxvoltage, double maxpower, double internalresistance, unsigned int location_id, bool global = false, pmr::memory_resource *resource = pmr::get_default_resource());
 	virtual ~PowerSource();
 
 	/**
@@ -82,17 +87,18 @@ public:
 	/**
 	* \brief register lambda that fires when the output current of this source changes.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnLoadChanged(function<void(PowerSource*)> lambda) { loadChange = lambda; };
+	virtual unsigned int OnLoadChanged(function<void(PowerSource*)> lambda);
 
 protected:
+	SOURCE_SOLVER_STATE *sourcestate = NULL;		//!< Per-frame state, allocated from the source table.
 
-	double maxpowerout = -1;				//!< maximum power output this source can provide in Watts.
-	double maxoutcurrent = -1;			//maximum current this source can provide in Amperes.
-	double internalresistance = -1;
-	double curroutputcurrent = -1;
-
-	function<void(PowerSource*)> loadChange = NULL;
+	/**
+	 * \brief Fires the load change event if the output current differs from before.
+	 * \param oldcurrent The output current before the change.
+	 */
+	void fireSourceLoadEvent(double oldcurrent);
 
 private:
 	unsigned int locationid = 0;
@@ -137,7 +143,8 @@ struct POWERSOURCE_STATS
 	*/
 	void Apply()
 	{
-		psource->SetRequestedCurrent(requestedcurrent);
+		//a limited source can't deliver what was requested from it.
+		psource->SetRequestedCurrent(deliveredcurrent);
 	}
 
 	PowerSource *psource = NULL;			//!< pointer to the powersource these stats are for.
@@ -1,6 +1,11 @@
 #pragma once
+
+struct CHARGABLE_SOLVER_STATE;
+
 class PowerSourceChargable : public PowerSource, public PowerConsumer
 {
+	friend class PowerCircuitManager;
+	friend class PowerEventQueue;
 public:
 
 	/**
@@ -15,6 +20,7 @@ public:
 	 *	relationships can only be formed with objects in the same location.
 	 * \param minimumcharchingload The minimum load (fraction of maxchargingpower) this chargable source needs to recharge.
 	 * \param global If true, this chargable source can form connections to other global objects regardless of their location.
+	 * \param resource The memory resource the adjacency of this source is allocated from. Use PowerCircuitManager::CreateChargableSource() to allocate from the resource of a manager.
 	 */
 	PowerSourceChargable(double minvoltage, 
 						 double maxvoltage, 
@@ -25,7 +31,8 @@ public:
 						 double internalresistance, 
 						 unsigned int location_id, 
 						 double minimumchargingload,
-						 bool global = false);
+						 bool global = false,
+						 pmr::memory_resource *resource = pmr::get_default_resource());
 
 	~PowerSourceChargable();
 
@@ -97,25 +104,32 @@ public:
 	/**
 	* \brief register lambda that fires when charge falls below 10%.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnChargeLow(function<void(PowerSourceChargable*)> lambda) { chargeLow = lambda; };
+	virtual unsigned int OnChargeLow(function<void(PowerSourceChargable*)> lambda);
 
 	/**
 	* \brief register lambda that fires when charge is depleted.
 	* \param lambda Lambda function that receives this as an argument.
+	* \return Id of the handler, to remove it with RemoveParentEventHandler().
 	*/
-	virtual void OnChargeEmpty(function<void(PowerSourceChargable*)> lambda) { chargeEmpty = lambda; };
+	virtual unsigned int OnChargeEmpty(function<void(PowerSourceChargable*)> lambda);
 
 protected:
-	double charge = -1;
-	double maxcharge = -1;
-	double efficiency = -1;
-	double autoswitchthreshold = 0.2;					//!< Source will not be automatically switched in to provide power if charge is below this threshold.
-	bool settocharging = false;							//!< if set to true, this source will attempt to charge no matter what. If set to false, autoswitch determinves the behavior. 
-	double lowchargelimit = -1;
-
-	function<void(PowerSourceChargable*)> chargeLow = NULL;
-	function<void(PowerSourceChargable*)> chargeEmpty = NULL;
+	CHARGABLE_SOLVER_STATE *chargablestate = NULL;		//!< Per-frame state, allocated from the chargable table. Source and consumer state are allocated by the respective base.
+
+
+	/**
+	 * \brief Fires the charge empty or charge low event if the charge crossed the respective limit.
+	 * \param oldcharge The charge before the change, in Wh.
+	 */
+	void fireChargeEvents(double oldcharge);
+
+	/**
+	 * \brief Fires the charge events, or defers them if the circuit is being evaluated.
+	 * \param oldcharge The charge before the change, in Wh.
+	 */
+	void registerChargeChange(double oldcharge);
 
 };
 
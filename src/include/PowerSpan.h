@@ -0,0 +1,26 @@
+#pragma once
+
+/**
+ * \brief Read-only view of a contiguous list that is owned by someone else.
+ * Returned by accessors that expose the internal lists of elements and circuits without copying them.
+ * \note A span is only valid until the list it views is changed, e.g. by connecting or disconnecting an element.
+ *	Don't hold on to it across structural changes, and don't change the structure while iterating over it.
+ */
+template<class T> class PowerSpan
+{
+public:
+	typedef const T *iterator;
+
+	PowerSpan(const T *first, unsigned int count)
+		: first(first), count(count) {};
+
+	iterator begin() const { return first; }
+	iterator end() const { return first + count; }
+	const T &operator[](unsigned int i) const { return first[i]; }
+	unsigned int size() const { return count; }
+	bool empty() const { return count == 0; }
+
+private:
+	const T *first;
+	unsigned int count;
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+
+class PowerBus;
+class PowerSource;
+class PowerConsumer;
+class PowerSourceChargable;
+
+/**
+ * \brief State of a bus at the end of an evaluation.
+ */
+struct BUS_STATE
+{
+	PowerBus *bus = NULL;						//!< Identifies the bus. Do not dereference from a reading thread!
+	POWER_HANDLE handle = 0;					//!< Handle of the bus, see PowerElementRegistry.
+	double current = 0;							//!< Current flowing through the bus, in Amperes.
+	double maxcurrent = 0;						//!< Maximum current the bus is designed for, in Amperes.
+};
+
+/**
+ * \brief State of a power source at the end of an evaluation.
+ */
+struct SOURCE_STATE
+{
+	PowerSource *source = NULL;					//!< Identifies the source. Do not dereference from a reading thread!
+	POWER_HANDLE handle = 0;					//!< Handle of the source, see PowerElementRegistry.
+	double outputcurrent = 0;					//!< Current flowing out of the source, in Amperes.
+	double poweroutput = 0;						//!< Current power output, in Watts.
+	double maxpoweroutput = 0;					//!< Maximum power output, in Watts.
+	bool switchedin = false;					//!< Whether the source is switched in.
+};
+
+/**
+ * \brief State of a consumer at the end of an evaluation.
+ */
+struct CONSUMER_STATE
+{
+	PowerConsumer *consumer = NULL;				//!< Identifies the consumer. Do not dereference from a reading thread!
+	POWER_HANDLE handle = 0;					//!< Handle of the consumer, see PowerElementRegistry.
+	double inputcurrent = 0;					//!< Current flowing into the consumer, in Amperes.
+	double load = 0;							//!< Load as a fraction of 1.
+	double powerconsumption = 0;				//!< Current power consumption, in Watts.
+	bool running = false;						//!< Whether the consumer is running.
+	bool switchedin = false;					//!< Whether the consumer is switched in.
+};
+
+/**
+ * \brief State of a rechargable source at the end of an evaluation.
+ * \note A rechargable source additionally appears in the source states, and in the consumer states if it is connected as a child.
+ */
+struct CHARGABLE_STATE
+{
+	PowerSourceChargable *chargable = NULL;		//!< Identifies the rechargable source. Do not dereference from a reading thread!
+	POWER_HANDLE handle = 0;					//!< Handle of the rechargable source, see PowerElementRegistry.
+	double charge = 0;							//!< Current charge, in Wh.
+	double maxcharge = 0;						//!< Maximum charge, in Wh.
+};
+
+/**
+ * \brief Immutable state of all elements in a PowerCircuitManager after one call to Evaluate().
+ * Every element kind is stored in one flat array. Elements appear in the order of the circuits, and in the order of the
+ * buses and sources within a circuit. Consumers appear in the order of the buses they are connected to.
+ */
+struct POWER_STATE_FRAME
+{
+	unsigned long long frame = 0;				//!< Number of the evaluation this state was taken after. Starts at 1, 0 means nothing was published yet.
+	vector<BUS_STATE> buses;
+	vector<SOURCE_STATE> sources;
+	vector<CONSUMER_STATE> consumers;
+	vector<CHARGABLE_STATE> chargables;
+};
+
+
+/**
+ * \brief Lock-free triple buffer that lets exactly one reading thread access the states published by a PowerCircuitManager.
+ * The simulation thread always has a buffer to write to, and the reader always has a buffer to read from,
+ * so neither of them ever has to wait for the other. Create one per reading thread with PowerCircuitManager::CreateStateBuffer().
+ */
+class PowerStateBuffer
+{
+	friend class PowerCircuitManager;
+public:
+
+	/**
+	 * \brief Gets the most recently published state.
+	 * The returned frame remains valid and unchanged until the next call to Acquire() from the same thread.
+	 * \return The newest state available, or the same state as the last call if nothing new was published since.
+	 * \note Must only be called from the single thread this buffer was created for!
+	 */
+	const POWER_STATE_FRAME *Acquire();
+
+	/**
+	 * \return True if a state was published since the last call to Acquire().
+	 */
+	bool HasNewFrame();
+
+private:
+	PowerStateBuffer();
+	~PowerStateBuffer();
+
+	/**
+	 * \return The frame the simulation thread is allowed to write to.
+	 */
+	POWER_STATE_FRAME *getWriteFrame();
+
+	/**
+	 * \brief Hands the frame returned by getWriteFrame() to the reader, and takes over a free one to write to next time.
+	 */
+	void publish();
+
+	static const unsigned int INDEX_MASK = 3;
+	static const unsigned int NEW_FRAME_FLAG = 4;
+
+	POWER_STATE_FRAME frames[3];
+	unsigned int writeindex = 0;				//!< Frame owned by the simulation thread.
+	unsigned int readindex = 1;					//!< Frame owned by the reading thread.
+	atomic<unsigned int> pendingindex;			//!< Frame last handed over, or'd with NEW_FRAME_FLAG if the reader has not taken it yet.
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+
+class PowerParent;
+class PowerSource;
+class PowerBus;
+class PowerCircuit;
+
+/**
+ * \brief Adjacency of all buses in a circuit, taken on the simulation thread after a structural change.
+ * Contains nothing but graph information, so it can be processed on another thread.
+ * Element pointers in here are only used as identifiers and are never dereferenced by the builder.
+ */
+struct TOPOLOGY_SNAPSHOT
+{
+	PowerCircuit *circuit = NULL;				//!< The circuit this snapshot was taken of.
+	unsigned int topologystamp = 0;				//!< The topology stamp the circuit had when the snapshot was taken.
+	vector<PowerSource*> sources;				//!< All sources of the circuit.
+	vector<PowerBus*> buses;					//!< All buses of the circuit.
+	vector<unsigned int> parentoffsets;			//!< The parents of bus i are stored in [parentoffsets[i], parentoffsets[i + 1]).
+	vector<unsigned int> parents;				//!< Flattened parent lists of all buses, as element indices: sources first, then buses.
+	bool reduce = false;						//!< Whether to reduce chains and leaves of buses, see TOPOLOGY_RESULT::edgebases.
+};
+
+/**
+ * \brief The reachability of all feeding edges in a circuit, ready to be swapped in on the simulation thread.
+ * Elements are identified by their index, sources first, then buses. See PowerReachabilityTable.
+ */
+struct TOPOLOGY_RESULT
+{
+	PowerCircuit *circuit = NULL;				//!< The circuit the result was built for.
+	unsigned int topologystamp = 0;				//!< Topology stamp of the snapshot this was built from.
+	vector<PowerSource*> sources;				//!< The sources of the circuit, in the same order as in the snapshot.
+	vector<PowerBus*> buses;					//!< The buses of the circuit, in the same order as in the snapshot.
+	vector<unsigned int> edgeoffsets;			//!< The feeding edges of bus i are [edgeoffsets[i], edgeoffsets[i + 1]). There is one edge per parent.
+	unsigned int maskwords = 0;					//!< The number of words in every mask.
+	vector<unsigned long long> masks;			//!< One bit per element for every edge with a mask, set if the element is upstream of the edge.
+	vector<int> edgemasks;						//!< For every edge, the index of its mask, or -1 if the edge is derived from another edge.
+
+	//a bus without sources and at most two neighbouring buses is a link in a chain or the end of one. As long as the chain isn't part of a loop,
+	//everything upstream of the edge coming from such a bus is that bus plus whatever is upstream of the edge feeding it from its other neighbour.
+	//These edges need no mask of their own.
+	vector<int> edgebases;						//!< For derived edges, the edge the bus the edge comes from is fed by, or -1 if it is a leaf and feeds only itself.
+	vector<unsigned int> edgeelements;			//!< For derived edges, the element the edge comes from.
+	vector<unsigned int> derivedorder;			//!< All derived edges, in an order in which bases come before the edges derived from them.
+};
+
+
+/**
+ * \brief Builds the reachability of the feeding edges of circuits on a worker thread.
+ * Snapshots are submitted from the simulation thread, results are collected at a frame boundary and
+ * swapped in by the PowerCircuitManager. The worker is started with the first submitted snapshot.
+ */
+class PowerTopologyBuilder
+{
+public:
+	PowerTopologyBuilder();
+	~PowerTopologyBuilder();
+
+	/**
+	 * \brief Queues a snapshot for processing on the worker thread.
+	 * \param snapshot The snapshot to process. The builder takes ownership.
+	 * \note Any snapshot of the same circuit that is still waiting in the queue is discarded, as its result would be outdated anyways.
+	 */
+	void Submit(TOPOLOGY_SNAPSHOT *snapshot);
+
+	/**
+	 * \brief Hands out all results that were finished since the last call.
+	 * \param OUT_results Initialised vector the results will be appended to. The caller takes ownership of the results.
+	 * \note Does not lock if no results are available, so it is cheap to call every frame.
+	 */
+	void CollectResults(vector<TOPOLOGY_RESULT*> &OUT_results);
+
+	/**
+	 * \brief Blocks until the worker has processed all submitted snapshots.
+	 */
+	void WaitUntilIdle();
+
+	/**
+	 * \brief Computes the elements upstream of every feeding edge in a snapshot.
+	 * Does not touch any elements, and can therefore run on any thread.
+	 * \param snapshot The adjacency to build from.
+	 * \return A newly allocated result. The caller takes ownership.
+	 */
+	static TOPOLOGY_RESULT *Build(TOPOLOGY_SNAPSHOT *snapshot);
+
+private:
+	thread worker;
+	mutex lock;									//!< Guards jobs, results, busy and stop.
+	condition_variable jobavailable;
+	condition_variable idle;
+	deque<TOPOLOGY_SNAPSHOT*> jobs;
+	vector<TOPOLOGY_RESULT*> results;
+	atomic<bool> resultsavailable;				//!< Lets the simulation thread check for results without locking.
+	bool busy = false;							//!< True while the worker is processing a snapshot.
+	bool stop = false;
+
+	/**
+	 * \brief The worker threads main loop.
+	 */
+	void work();
+
+	/**
+	 * \brief Marks the edges of a result that can be derived from other edges, see TOPOLOGY_RESULT::edgebases.
+	 * Must be called before the masks are built, so no masks are built for derived edges.
+	 */
+	static void reduce(TOPOLOGY_SNAPSHOT *snapshot, TOPOLOGY_RESULT *result);
+};
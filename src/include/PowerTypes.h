@@ -6,6 +6,12 @@
 
 const double MILIS_PER_HOUR = 3600 * 1000;			//!< number of miliseconds in an hour.
 
+/**
+ * \brief Identifies an element in the PowerElementRegistry of its PowerCircuitManager.
+ * 0 never identifies an element.
+ */
+typedef unsigned int POWER_HANDLE;
+
 /**
 * Contains the maximum, minimum and current voltage of a parent/child.
 */